@@ -0,0 +1,320 @@
+// Benchmarks de la red con datos sintéticos (no hace falta MNIST). Cubren los
+// kernels (distance_sq, find_bmu, update_weights), una época de train por
+// NeighborhoodMode, test_accuracy, assign_labels, Reader::load_csv y
+// save_weights / load_weights, variando el tamaño de la malla, la dimensión
+// de entrada y el número de hilos. find_bmu y train se miden también con los
+// kernels genéricos (sufijo "/generic") frente a los especializados por
+// dimensión de entrada. El resultado es JSON con un orden de
+// claves estable, para comparar builds con diff.
+//
+// Uso: KohonenBench [--quick] [--filter <texto>] [--out <archivo.json>]
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <omp.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Kernels.hpp"
+#include "Reader.hpp"
+#include "RedKohonen.hpp"
+#include "Utils.hpp"
+
+using namespace std;
+
+namespace
+{
+    using Real = float;
+
+    struct Config
+    {
+        int dim_x, dim_y, dim_z;
+        int input_dim;
+        int threads;
+
+        string grid() const
+        {
+            return to_string(dim_x) + "x" + to_string(dim_y) + "x" + to_string(dim_z);
+        }
+    };
+
+    struct Result
+    {
+        string name;
+        Config config;
+        size_t iterations;
+        double items; // Elementos procesados por iteración (muestras, neuronas, filas)
+        double mean_ns, median_ns, min_ns;
+    };
+
+    // Descarta la salida de cout mientras exista (train y load_weights informan por consola)
+    class SilenceCout
+    {
+        ostringstream sink;
+        streambuf *saved;
+
+    public:
+        SilenceCout() : saved(cout.rdbuf(sink.rdbuf())) {}
+        ~SilenceCout() { cout.rdbuf(saved); }
+    };
+
+    // Ejecuta `body` una vez para calentar y luego hasta acumular min_seconds
+    // (y al menos min_reps repeticiones)
+    template <typename F>
+    Result measure(const string &name, const Config &config, double items, double min_seconds, size_t min_reps,
+                   F &&body)
+    {
+        body();
+        vector<double> times;
+        double total = 0.0;
+        while (total < min_seconds || times.size() < min_reps)
+        {
+            auto start = start_timer();
+            body();
+            double seconds = stop_timer(start);
+            times.push_back(seconds * 1e9);
+            total += seconds;
+        }
+
+        Result r{name, config, times.size(), items, 0.0, 0.0, 0.0};
+        for (double t : times)
+            r.mean_ns += t;
+        r.mean_ns /= times.size();
+        r.min_ns = *min_element(times.begin(), times.end());
+        r.median_ns = percentile(times, 0.5);
+        return r;
+    }
+
+    // Muestras sintéticas con la estructura de MNIST: ~80% de ceros
+    Matrix<Real> synthetic_samples(size_t rows, int dims, mt19937 &gen)
+    {
+        uniform_real_distribution<Real> value(0.0, 1.0);
+        bernoulli_distribution nonzero(0.2);
+        Matrix<Real> X(rows, dims);
+        for (size_t i = 0; i < rows; ++i)
+            for (int j = 0; j < dims; ++j)
+                X.row(i)[j] = nonzero(gen) ? value(gen) : Real(0);
+        return X;
+    }
+
+    vector<int> synthetic_labels(size_t rows, mt19937 &gen)
+    {
+        uniform_int_distribution<int> digit(0, 9);
+        vector<int> Y(rows);
+        for (int &y : Y)
+            y = digit(gen);
+        return Y;
+    }
+
+    // CSV con el formato de Reader::load_csv: píxeles y etiqueta one-hot
+    void write_csv(const string &filename, const Matrix<Real> &X, const vector<int> &Y)
+    {
+        ofstream out(filename);
+        for (size_t i = 0; i < X.rows(); ++i)
+        {
+            for (size_t j = 0; j < X.cols(); ++j)
+                out << X.row(i)[j] << ',';
+            for (int c = 0; c < 10; ++c)
+                out << (c == Y[i] ? 1 : 0) << (c < 9 ? ',' : '\n');
+        }
+    }
+
+    string to_json(const vector<Result> &results, bool quick)
+    {
+        ostringstream out;
+        out << "{\n  \"context\": {\"isa\": \"" << kernels::isa_name() << "\", \"max_threads\": " << omp_get_max_threads()
+            << ", \"scalar\": \"float\", \"quick\": " << (quick ? "true" : "false") << "},\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &r = results[i];
+            out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"grid\": \"" << r.config.grid()
+                << "\", \"input_dim\": " << r.config.input_dim << ", \"threads\": " << r.config.threads
+                << ", \"iterations\": " << r.iterations << ", \"mean_ns\": " << r.mean_ns
+                << ", \"median_ns\": " << r.median_ns << ", \"min_ns\": " << r.min_ns
+                << ", \"items_per_iteration\": " << r.items
+                << ", \"items_per_second\": " << r.items / (r.median_ns * 1e-9) << "}";
+        }
+        out << "\n  ]\n}\n";
+        return out.str();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool quick = false;
+    string filter, out_file;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--quick")
+            quick = true;
+        else if (arg == "--filter" && i + 1 < argc)
+            filter = argv[++i];
+        else if (arg == "--out" && i + 1 < argc)
+            out_file = argv[++i];
+        else
+        {
+            cerr << "Uso: " << argv[0] << " [--quick] [--filter <texto>] [--out <archivo.json>]" << endl;
+            return 1;
+        }
+    }
+
+    // --- PARÁMETROS ---
+    const vector<int> GRIDS = quick ? vector<int>{5, 10} : vector<int>{5, 10, 16};
+    const vector<int> INPUT_DIMS = {64, 784};
+    vector<int> thread_counts = {1, omp_get_max_threads()};
+    thread_counts.erase(unique(thread_counts.begin(), thread_counts.end()), thread_counts.end());
+    const size_t TRAIN_SAMPLES = quick ? 1000 : 5000;
+    const size_t EVAL_SAMPLES = quick ? 1000 : 5000;
+    const size_t CSV_ROWS = quick ? 500 : 2000;
+    const double MIN_SECONDS = quick ? 0.05 : 0.3; // Por benchmark
+    const size_t MIN_REPS = quick ? 1 : 3;
+    const size_t MICRO_SAMPLES = 64; // Muestras por iteración en los micro-benchmarks
+
+    const filesystem::path tmp_dir = filesystem::temp_directory_path();
+    const string csv_file = (tmp_dir / "kohonen_bench.csv").string();
+    const string weights_file = (tmp_dir / "kohonen_bench.dat").string();
+
+    vector<Result> results;
+    auto selected = [&](const string &name) { return filter.empty() || name.find(filter) != string::npos; };
+    auto record = [&](Result r)
+    {
+        cerr << r.name << " " << r.config.grid() << " d" << r.config.input_dim << " t" << r.config.threads << ": "
+             << r.median_ns / 1e6 << " ms/iter (" << r.iterations << " iter)" << endl;
+        results.push_back(std::move(r));
+    };
+
+    for (int side : GRIDS)
+    {
+        for (int input_dim : INPUT_DIMS)
+        {
+            mt19937 gen(42);
+            Matrix<Real> X_train = synthetic_samples(TRAIN_SAMPLES, input_dim, gen);
+            Matrix<Real> X_eval = synthetic_samples(EVAL_SAMPLES, input_dim, gen);
+            vector<int> Y_eval = synthetic_labels(EVAL_SAMPLES, gen);
+            vector<vector<Real>> micro(MICRO_SAMPLES);
+            for (size_t s = 0; s < MICRO_SAMPLES; ++s)
+                micro[s].assign(X_eval.row(s), X_eval.row(s) + input_dim);
+
+            for (int threads : thread_counts)
+            {
+                omp_set_num_threads(threads);
+                const Config config{side, side, side, input_dim, threads};
+                const int neurons = side * side * side;
+                BasicRedKohonen<Real> som(input_dim, side, side, side, 0.5, 1);
+
+                // --- Micro-benchmarks ---
+                if (selected("distance_sq"))
+                    record(measure("distance_sq", config, double(MICRO_SAMPLES) * neurons, MIN_SECONDS, MIN_REPS, [&]
+                                   {
+                                       double sink = 0.0;
+                                       for (const auto &x : micro)
+                                           for (int i = 0; i < neurons; ++i)
+                                               sink += som.neuron(i).distance_sq(x);
+                                       if (sink < 0.0)
+                                           cerr << sink; }));
+
+                // "/generic": los mismos casos con los kernels de longitud variable
+                for (bool fixed : {true, false})
+                {
+                    const string suffix = fixed ? "" : "/generic";
+                    som.set_fixed_dim_kernels(fixed);
+                    if (selected("find_bmu" + suffix))
+                        record(measure("find_bmu" + suffix, config, MICRO_SAMPLES, MIN_SECONDS, MIN_REPS, [&]
+                                       {
+                                           int sink = 0;
+                                           for (const auto &x : micro)
+                                               sink += get<0>(som.find_bmu_coords(x));
+                                           if (sink < 0)
+                                               cerr << sink; }));
+                }
+                som.set_fixed_dim_kernels(true);
+
+                // Pesos copiados: las actualizaciones repetidas no alteran la red de los demás benchmarks
+                if (selected("update_weights"))
+                {
+                    Matrix<Real> weights = som.get_codebook();
+                    record(measure("update_weights", config, double(MICRO_SAMPLES) * neurons, MIN_SECONDS, MIN_REPS, [&]
+                                   {
+                                       for (const auto &x : micro)
+                                           for (int i = 0; i < neurons; ++i)
+                                               Neuron<Real>(weights.row(i), input_dim).update_weights(x, 0.01, 0.5); }));
+                }
+
+                // --- Macro-benchmarks ---
+                const pair<NeighborhoodMode, const char *> modes[] = {
+                    {NeighborhoodMode::BMU_ONLY, "train_epoch/bmu_only"},
+                    {NeighborhoodMode::GAUSSIAN_RADIUS, "train_epoch/gaussian_radius"},
+                    {NeighborhoodMode::CONSTANT_RADIUS, "train_epoch/constant_radius"}};
+                for (const auto &[mode, mode_name] : modes)
+                {
+                    for (bool fixed : {true, false})
+                    {
+                        const string name = string(mode_name) + (fixed ? "" : "/generic");
+                        if (!selected(name))
+                            continue;
+                        BasicRedKohonen<Real> trained(input_dim, side, side, side, 0.5, 1, mode);
+                        trained.set_fixed_dim_kernels(fixed);
+                        record(measure(name, config, TRAIN_SAMPLES, MIN_SECONDS, 1, [&]
+                                       {
+                                           SilenceCout silence;
+                                           trained.train(0, X_train, nullptr); }));
+                    }
+                }
+
+                if (selected("assign_labels"))
+                    record(measure("assign_labels", config, EVAL_SAMPLES, MIN_SECONDS, MIN_REPS,
+                                   [&] { som.assign_labels(X_eval, Y_eval); }));
+
+                if (selected("test_accuracy"))
+                    record(measure("test_accuracy", config, EVAL_SAMPLES, MIN_SECONDS, MIN_REPS, [&]
+                                   {
+                                       float acc = som.test_accuracy(X_eval, Y_eval);
+                                       if (acc < 0.0f)
+                                           cerr << acc; }));
+
+                if (selected("save_weights"))
+                    record(measure("save_weights", config, neurons, MIN_SECONDS, MIN_REPS,
+                                   [&] { som.save_weights(weights_file); }));
+
+                if (selected("load_weights"))
+                {
+                    som.save_weights(weights_file);
+                    BasicRedKohonen<Real> loaded(input_dim, side, side, side);
+                    record(measure("load_weights", config, neurons, MIN_SECONDS, MIN_REPS, [&]
+                                   {
+                                       SilenceCout silence;
+                                       loaded.load_weights(weights_file); }));
+                }
+
+                // Solo depende de la dimensión de entrada (una vez por malla y hilos, como el resto)
+                if (selected("load_csv"))
+                {
+                    Matrix<Real> rows = X_eval.slice(0, min(CSV_ROWS, X_eval.rows()));
+                    write_csv(csv_file, rows, Y_eval);
+                    record(measure("load_csv", config, rows.rows(), MIN_SECONDS, MIN_REPS, [&]
+                                   {
+                                       vector<vector<double>> X, Y;
+                                       Reader::load_csv(csv_file, X, Y, 10); }));
+                }
+            }
+        }
+    }
+
+    filesystem::remove(csv_file);
+    filesystem::remove(weights_file);
+
+    string json = to_json(results, quick);
+    if (out_file.empty())
+        cout << json;
+    else
+    {
+        ofstream out(out_file);
+        out << json;
+        cerr << "Resultados en " << out_file << endl;
+    }
+    return 0;
+}
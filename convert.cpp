@@ -2,11 +2,70 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstring>
 #include <cassert>
 #include <iomanip>
 
+#include "DatasetFormat.hpp"
+#include "Idx.hpp"
+
 using namespace std;
 
+// Escribe el dataset en el formato binario .kds (ver include/DatasetFormat.hpp):
+// filas alineadas de tipo T, listas para mapearse con Reader::map_dataset.
+// MNIST se escribe en uint8_t, el tipo que usan el entrenamiento y el
+// visualizador (Reader::load_mnist)
+template <typename T>
+void convert_mnist_to_binary(const string &image_file, const string &label_file, const string &output_file, int limit = -1)
+{
+    ifstream images(image_file, ios::binary);
+    ifstream labels(label_file, ios::binary);
+    ofstream output(output_file, ios::binary);
+
+    assert(images.is_open() && "No se pudo abrir el archivo de imagenes");
+    assert(labels.is_open() && "No se pudo abrir el archivo de etiquetas");
+
+    // Leer cabeceras (big-endian)
+    idx::Header image_header, label_header;
+    bool images_ok = idx::read_images_header(images, image_header);
+    bool labels_ok = idx::read_labels_header(labels, label_header);
+    assert(images_ok && labels_ok);
+    assert(image_header.count == label_header.count);
+
+    int num_images = image_header.count;
+    if (limit < 0 || limit > num_images)
+        limit = num_images;
+
+    int image_size = image_header.rows * image_header.cols;
+    dataset_format::Header header = dataset_format::make_header(
+        limit, image_size, dataset_format::dtype_of<T>(), 10);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    // Muestras: una fila por imagen, normalizada a [0,1] (salvo uint8) y rellena con ceros
+    vector<unsigned char> pixels(image_size);
+    vector<T> row(header.row_stride, T(0));
+    for (int i = 0; i < limit; ++i)
+    {
+        images.read(reinterpret_cast<char *>(pixels.data()), image_size);
+        for (int j = 0; j < image_size; ++j)
+        {
+            if constexpr (is_same<T, uint8_t>::value)
+                row[j] = pixels[j];
+            else
+                row[j] = static_cast<T>(pixels[j] / 255.0);
+        }
+        output.write(reinterpret_cast<const char *>(row.data()), row.size() * sizeof(T));
+    }
+
+    // Etiquetas: un int32 por muestra
+    vector<unsigned char> raw_labels(limit);
+    labels.read(reinterpret_cast<char *>(raw_labels.data()), limit);
+    vector<int32_t> label_indices(raw_labels.begin(), raw_labels.end());
+    output.write(reinterpret_cast<const char *>(label_indices.data()), label_indices.size() * sizeof(int32_t));
+
+    cout << "Dataset binario generado con " << limit << " ejemplos: " << output_file << endl;
+}
+
 void convert_mnist_to_csv(const string &image_file, const string &label_file, const string &output_csv, int limit = -1)
 {
     ifstream images(image_file, ios::binary);
@@ -16,31 +75,15 @@ void convert_mnist_to_csv(const string &image_file, const string &label_file, co
     assert(images.is_open() && "No se pudo abrir el archivo de imagenes");
     assert(labels.is_open() && "No se pudo abrir el archivo de etiquetas");
 
-    // Leer cabecera de imagenes
-    int32_t magic_images = 0, num_images = 0, rows = 0, cols = 0;
-    images.read(reinterpret_cast<char *>(&magic_images), 4);
-    images.read(reinterpret_cast<char *>(&num_images), 4);
-    images.read(reinterpret_cast<char *>(&rows), 4);
-    images.read(reinterpret_cast<char *>(&cols), 4);
-
-    // Leer cabecera de etiquetas
-    int32_t magic_labels = 0, num_labels = 0;
-    labels.read(reinterpret_cast<char *>(&magic_labels), 4);
-    labels.read(reinterpret_cast<char *>(&num_labels), 4);
-
-    // Convertir endian
-    magic_images = __builtin_bswap32(magic_images);
-    num_images = __builtin_bswap32(num_images);
-    rows = __builtin_bswap32(rows);
-    cols = __builtin_bswap32(cols);
-    magic_labels = __builtin_bswap32(magic_labels);
-    num_labels = __builtin_bswap32(num_labels);
-
-    assert(magic_images == 2051);
-    assert(magic_labels == 2049);
-    assert(num_images == num_labels);
-
-    int image_size = rows * cols;
+    // Leer cabeceras (big-endian)
+    idx::Header image_header, label_header;
+    bool images_ok = idx::read_images_header(images, image_header);
+    bool labels_ok = idx::read_labels_header(labels, label_header);
+    assert(images_ok && labels_ok);
+    assert(image_header.count == label_header.count);
+
+    int num_images = image_header.count;
+    int image_size = image_header.rows * image_header.cols;
     unsigned char pixel;
     unsigned char label;
 
@@ -81,20 +124,41 @@ void convert_mnist_to_csv(const string &image_file, const string &label_file, co
     cout << "Archivo CSV generado con " << limit << " ejemplos: " << output_csv << endl;
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    convert_mnist_to_csv(
+    // Por defecto se genera el formato binario; --csv conserva el formato anterior
+    bool csv = argc > 1 && strcmp(argv[1], "--csv") == 0;
+
+    if (csv)
+    {
+        convert_mnist_to_csv(
+            "database/train-images.idx3-ubyte",
+            "database/train-labels.idx1-ubyte",
+            "database/mnist_train_flat_3.csv",
+            60000 // o un numero menor para pruebas
+        );
+
+        convert_mnist_to_csv(
+            "database/t10k-images.idx3-ubyte", // imagenes de prueba
+            "database/t10k-labels.idx1-ubyte", // etiquetas de prueba
+            "database/mnist_test_flat.csv",    // archivo de salida
+            10000                              // o un numero menor para pruebas
+        );
+        return 0;
+    }
+
+    convert_mnist_to_binary<uint8_t>(
         "database/train-images.idx3-ubyte",
         "database/train-labels.idx1-ubyte",
-        "database/mnist_train_flat_3.csv",
+        "database/mnist_train.kds",
         60000 // o un numero menor para pruebas
     );
 
-    convert_mnist_to_csv(
-        "database/t10k-images.idx3-ubyte", // imagenes de prueba
-        "database/t10k-labels.idx1-ubyte", // etiquetas de prueba
-        "database/mnist_test_flat.csv",    // archivo de salida
-        10000                              // o un numero menor para pruebas
+    convert_mnist_to_binary<uint8_t>(
+        "database/t10k-images.idx3-ubyte",
+        "database/t10k-labels.idx1-ubyte",
+        "database/mnist_test.kds",
+        10000
     );
 
     return 0;
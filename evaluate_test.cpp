@@ -0,0 +1,75 @@
+// Comprueba BasicRedKohonen::evaluate con etiquetas bien y mal formadas: si Y no
+// tiene una etiqueta por muestra, la evaluación debe salir vacía (también en
+// Release, donde NDEBUG quita los assert) y no tocar las etiquetas de la red.
+//
+// Uso: KohonenEvaluateTest
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Matrix.hpp"
+#include "RedKohonen.hpp"
+
+using namespace std;
+
+namespace
+{
+    int failures = 0;
+
+    void expect(const string &what, bool ok)
+    {
+        if (!ok)
+        {
+            cerr << "FALLO " << what << endl;
+            ++failures;
+        }
+    }
+}
+
+int main()
+{
+    const int dim = 16, samples = 40;
+    mt19937 gen(7);
+    uniform_real_distribution<double> dis(0.0, 1.0);
+    Matrix<double> X(samples, dim);
+    vector<int> Y(samples);
+    for (int i = 0; i < samples; ++i)
+    {
+        for (int j = 0; j < dim; ++j)
+            X.row(i)[j] = dis(gen);
+        Y[i] = i % 3;
+    }
+
+    RedKohonen som(dim, 3, 3, 1, 0.5, 1);
+
+    const Evaluation ok = som.evaluate(X, Y);
+    expect("evaluación normal con error de cuantización", ok.quantization_error > 0.0);
+    const vector<int> labels = som.get_labels();
+
+    // Menos etiquetas que muestras: evaluación vacía y etiquetas intactas
+    vector<int> short_Y(Y.begin(), Y.end() - 1);
+    const Evaluation bad = som.evaluate(X, short_Y);
+    expect("Y corta: precisión 0", bad.accuracy == 0.0f);
+    expect("Y corta: error de cuantización 0", bad.quantization_error == 0.0);
+    expect("Y corta: etiquetas sin cambios", som.get_labels() == labels);
+
+    // Más etiquetas que muestras
+    vector<int> long_Y = Y;
+    long_Y.push_back(0);
+    const Evaluation bad_long = som.evaluate(X, long_Y);
+    expect("Y larga: evaluación vacía", bad_long.accuracy == 0.0f && bad_long.quantization_error == 0.0);
+    expect("Y larga: etiquetas sin cambios", som.get_labels() == labels);
+
+    // Sin ninguna etiqueta (todas < 0): precisión 0, pero sí hay error de
+    // cuantización
+    const Evaluation unlabeled = som.evaluate(X, vector<int>(samples, -1));
+    expect("sin etiquetas: precisión 0", unlabeled.accuracy == 0.0f);
+    expect("sin etiquetas: mismo error de cuantización", unlabeled.quantization_error == ok.quantization_error);
+    expect("sin etiquetas: etiquetas sin cambios", som.get_labels() == labels);
+
+    if (failures > 0)
+        return 1;
+    cout << "evaluate: OK" << endl;
+    return 0;
+}
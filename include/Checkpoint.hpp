@@ -0,0 +1,237 @@
+#pragma once
+
+#include "DatasetFormat.hpp"
+#include "Matrix.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// Formato binario de checkpoints de la red (.dat), compartido por el
+// entrenamiento (guardar / reanudar) y el visualizador:
+//
+//   [cabecera de 128 bytes][etiquetas int32][relleno][pesos fila-mayor]
+//
+// Las filas de pesos usan el mismo relleno que Matrix y empiezan alineadas a
+// 64 bytes, así que al mapear el archivo el codebook se usa sin copiarlo.
+// El checksum cubre todo lo que sigue a la cabecera.
+namespace checkpoint
+{
+  constexpr char MAGIC[4] = {'K', 'S', 'O', 'M'};
+  constexpr uint32_t VERSION = 1;
+  constexpr uint32_t ALIGNMENT = 64;
+
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t dim_x, dim_y, dim_z;
+    uint32_t input_dim;
+    uint32_t dtype;          // dataset_format::DType de los pesos
+    uint32_t alignment;      // Alineación de cada fila, en bytes
+    uint64_t row_stride;     // Elementos por fila, incluido el relleno
+    uint64_t labels_offset;  // Inicio de las etiquetas, en bytes
+    uint64_t weights_offset; // Inicio de los pesos, en bytes
+    uint64_t file_size;
+    int32_t epoch;           // Última época completada (-1 si no hubo entrenamiento)
+    uint32_t reserved;
+    double learning_rate;    // Estado del entrenamiento en esa época
+    double radius;
+    uint64_t checksum;       // FNV-1a sobre palabras de 64 bits
+    uint8_t padding[32];
+  };
+  static_assert(sizeof(Header) == 128, "la cabecera debe ocupar exactamente 128 bytes");
+
+  // Estado del entrenamiento guardado junto a los pesos
+  struct State
+  {
+    int epoch = -1;
+    double learning_rate = 0.0;
+    double radius = 0.0;
+  };
+
+  // Contenido de un checkpoint cargado
+  template <typename T>
+  struct Data
+  {
+    int dim_x = 0, dim_y = 0, dim_z = 0;
+    Matrix<T> weights; // Vista sobre el archivo mapeado (o copia si cambia el tipo)
+    std::vector<int> labels;
+    State state;
+  };
+
+  inline uint64_t align_up(uint64_t value, uint64_t alignment)
+  {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  // Las regiones tienen tamaño múltiplo de 8 (todas empiezan y terminan alineadas)
+  inline uint64_t fnv1a(const void *data, size_t bytes, uint64_t hash = 14695981039346656037ull)
+  {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i + 8 <= bytes; i += 8)
+    {
+      uint64_t word;
+      std::memcpy(&word, p + i, 8);
+      hash = (hash ^ word) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  // Escribe el checkpoint en un archivo temporal y lo renombra, para que un
+  // corte a mitad de escritura no deje un checkpoint corrupto
+  template <typename T>
+  bool save(const std::string &filename, const Matrix<T> &weights, int dim_x, int dim_y, int dim_z,
+            const std::vector<int> &labels, const State &state)
+  {
+    Header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.dim_x = dim_x;
+    h.dim_y = dim_y;
+    h.dim_z = dim_z;
+    h.input_dim = static_cast<uint32_t>(weights.cols());
+    h.dtype = static_cast<uint32_t>(dataset_format::dtype_of<T>());
+    h.alignment = ALIGNMENT;
+    h.row_stride = weights.stride();
+    h.labels_offset = sizeof(Header);
+    h.weights_offset = align_up(h.labels_offset + weights.rows() * sizeof(int32_t), ALIGNMENT);
+    h.file_size = h.weights_offset + weights.rows() * weights.stride() * sizeof(T);
+    h.epoch = state.epoch;
+    h.learning_rate = state.learning_rate;
+    h.radius = state.radius;
+
+    std::vector<char> labels_block(h.weights_offset - h.labels_offset, 0);
+    for (size_t i = 0; i < weights.rows() && i < labels.size(); ++i)
+    {
+      int32_t label = labels[i];
+      std::memcpy(labels_block.data() + i * sizeof(int32_t), &label, sizeof(label));
+    }
+
+    h.checksum = fnv1a(labels_block.data(), labels_block.size());
+    if (!weights.empty())
+      h.checksum = fnv1a(weights.data(), weights.rows() * weights.stride() * sizeof(T), h.checksum);
+
+    std::string tmp = filename + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary);
+      if (!out.is_open())
+      {
+        std::cerr << "Error al guardar checkpoint: " << filename << std::endl;
+        return false;
+      }
+      out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+      out.write(labels_block.data(), labels_block.size());
+      if (!weights.empty())
+        out.write(reinterpret_cast<const char *>(weights.data()), weights.rows() * weights.stride() * sizeof(T));
+      if (!out)
+      {
+        std::cerr << "Error al escribir checkpoint: " << filename << std::endl;
+        return false;
+      }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+      std::cerr << "Error al reemplazar checkpoint: " << filename << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Mapea un checkpoint y valida cabecera, tamaños y checksum. Si los pesos
+  // están guardados en el tipo T se usan directamente desde el mapeo
+  // (MAP_PRIVATE: se pueden seguir entrenando sin tocar el archivo); si no,
+  // se convierten a una matriz nueva.
+  template <typename T>
+  bool load(const std::string &filename, Data<T> &out)
+  {
+    using dataset_format::DType;
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      std::cerr << "Error al abrir checkpoint: " << filename << std::endl;
+      return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+    {
+      std::cerr << "Error: Checkpoint vacío o truncado: " << filename << std::endl;
+      ::close(fd);
+      return false;
+    }
+
+    size_t length = static_cast<size_t>(st.st_size);
+    void *base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+      std::cerr << "Error: No se pudo mapear el checkpoint " << filename << std::endl;
+      return false;
+    }
+    std::shared_ptr<void> mapping(base, [length](void *p) { munmap(p, length); });
+
+    Header h;
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION)
+    {
+      std::cerr << "Error: " << filename << " no es un checkpoint compatible." << std::endl;
+      return false;
+    }
+
+    DType dtype = static_cast<DType>(h.dtype);
+    size_t elem = dataset_format::dtype_size(dtype);
+    uint64_t neurons = static_cast<uint64_t>(h.dim_x) * h.dim_y * h.dim_z;
+    if ((dtype != DType::FLOAT32 && dtype != DType::FLOAT64) || h.row_stride < h.input_dim ||
+        h.file_size != length || h.weights_offset % ALIGNMENT != 0 ||
+        h.labels_offset + neurons * sizeof(int32_t) > h.weights_offset ||
+        h.weights_offset + neurons * h.row_stride * elem != length)
+    {
+      std::cerr << "Error: Cabecera inconsistente en " << filename << std::endl;
+      return false;
+    }
+
+    char *bytes = static_cast<char *>(base);
+    if (fnv1a(bytes + h.labels_offset, length - h.labels_offset) != h.checksum)
+    {
+      std::cerr << "Error: Checksum inválido en " << filename << std::endl;
+      return false;
+    }
+
+    out.dim_x = h.dim_x;
+    out.dim_y = h.dim_y;
+    out.dim_z = h.dim_z;
+    out.state = {h.epoch, h.learning_rate, h.radius};
+
+    const int32_t *labels = reinterpret_cast<const int32_t *>(bytes + h.labels_offset);
+    out.labels.assign(labels, labels + neurons);
+
+    if (dtype == dataset_format::dtype_of<T>())
+    {
+      out.weights = Matrix<T>::wrap(reinterpret_cast<T *>(bytes + h.weights_offset), neurons, h.input_dim,
+                                    h.row_stride, mapping);
+      return true;
+    }
+
+    out.weights = Matrix<T>(neurons, h.input_dim);
+    for (uint64_t i = 0; i < neurons; ++i)
+    {
+      const char *row = bytes + h.weights_offset + i * h.row_stride * elem;
+      T *dst = out.weights.row(i);
+      if (dtype == DType::FLOAT32)
+        std::copy_n(reinterpret_cast<const float *>(row), h.input_dim, dst);
+      else
+        std::copy_n(reinterpret_cast<const double *>(row), h.input_dim, dst);
+    }
+    return true;
+  }
+}
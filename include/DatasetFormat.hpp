@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Formato binario de datasets (.kds), pensado para mapearse con mmap:
+//
+//   [cabecera de 64 bytes][muestras fila-mayor][etiquetas int32]
+//
+// Cada fila de muestras se rellena con ceros hasta `alignment` bytes, así que
+// al mapear el archivo las filas quedan tan alineadas como las de Matrix.
+// Los enteros se guardan en el orden de bytes nativo (little-endian en x86).
+namespace dataset_format
+{
+  constexpr char MAGIC[4] = {'K', 'D', 'S', 'F'};
+  constexpr uint32_t VERSION = 1;
+  constexpr uint32_t ALIGNMENT = 64;
+
+  enum class DType : uint32_t
+  {
+    UINT8 = 1,
+    FLOAT32 = 2,
+    FLOAT64 = 3
+  };
+
+  enum class LabelLayout : uint32_t
+  {
+    NONE = 0,       // Sin etiquetas
+    INDEX_INT32 = 1 // Un int32 por fila con el índice de clase
+  };
+
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    uint64_t rows;
+    uint64_t dims;
+    uint32_t dtype;         // DType
+    uint32_t label_layout;  // LabelLayout
+    uint32_t num_classes;
+    uint32_t alignment;     // Alineación de cada fila, en bytes
+    uint64_t row_stride;    // Elementos por fila, incluido el relleno
+    uint64_t data_offset;   // Inicio de las muestras, en bytes
+    uint64_t labels_offset; // Inicio de las etiquetas, en bytes
+  };
+  static_assert(sizeof(Header) == 64, "la cabecera debe ocupar exactamente 64 bytes");
+
+  inline size_t dtype_size(DType dtype)
+  {
+    switch (dtype)
+    {
+    case DType::UINT8:
+      return 1;
+    case DType::FLOAT32:
+      return 4;
+    case DType::FLOAT64:
+      return 8;
+    }
+    return 0;
+  }
+
+  template <typename T>
+  constexpr DType dtype_of();
+  template <>
+  constexpr DType dtype_of<uint8_t>() { return DType::UINT8; }
+  template <>
+  constexpr DType dtype_of<float>() { return DType::FLOAT32; }
+  template <>
+  constexpr DType dtype_of<double>() { return DType::FLOAT64; }
+
+  // Cabecera completa para un dataset de rows x dims del tipo indicado
+  inline Header make_header(uint64_t rows, uint64_t dims, DType dtype, uint32_t num_classes)
+  {
+    Header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.rows = rows;
+    h.dims = dims;
+    h.dtype = static_cast<uint32_t>(dtype);
+    h.label_layout = static_cast<uint32_t>(num_classes > 0 ? LabelLayout::INDEX_INT32 : LabelLayout::NONE);
+    h.num_classes = num_classes;
+    h.alignment = ALIGNMENT;
+
+    size_t per_line = ALIGNMENT / dtype_size(dtype);
+    h.row_stride = (dims + per_line - 1) / per_line * per_line;
+    h.data_offset = sizeof(Header);
+    h.labels_offset = h.data_offset + rows * h.row_stride * dtype_size(dtype);
+    return h;
+  }
+}
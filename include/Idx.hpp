@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+
+// Cabeceras del formato IDX original de MNIST (train-images.idx3-ubyte,
+// train-labels.idx1-ubyte, ...). Los enteros están en big-endian.
+namespace idx
+{
+  constexpr int32_t IMAGES_MAGIC = 2051;
+  constexpr int32_t LABELS_MAGIC = 2049;
+
+  struct Header
+  {
+    int32_t magic = 0;
+    int32_t count = 0;
+    int32_t rows = 0; // Solo en archivos de imágenes
+    int32_t cols = 0;
+  };
+
+  inline int32_t read_be32(std::istream &in)
+  {
+    int32_t value = 0;
+    in.read(reinterpret_cast<char *>(&value), 4);
+    return __builtin_bswap32(value);
+  }
+
+  // Lee la cabecera de un archivo de imágenes; false si el número mágico no coincide
+  inline bool read_images_header(std::istream &in, Header &h)
+  {
+    h.magic = read_be32(in);
+    h.count = read_be32(in);
+    h.rows = read_be32(in);
+    h.cols = read_be32(in);
+    return in.good() && h.magic == IMAGES_MAGIC;
+  }
+
+  // Lee la cabecera de un archivo de etiquetas; false si el número mágico no coincide
+  inline bool read_labels_header(std::istream &in, Header &h)
+  {
+    h.magic = read_be32(in);
+    h.count = read_be32(in);
+    return in.good() && h.magic == LABELS_MAGIC;
+  }
+}
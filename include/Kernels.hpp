@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels de distancia con despacho en tiempo de ejecución.
+// La implementación (AVX-512, AVX2, SSE2 o escalar) se elige una sola vez
+// a partir de CPUID; la variable de entorno KOHONEN_ISA permite forzar una
+// implementación más simple ("avx2", "sse2", "scalar") para comparar.
+//
+// Cada kernel existe para double y para float. Con float las sumas parciales
+// se hacen en los lanes de float (el doble de elementos por registro) y el
+// resultado se entrega en double.
+namespace kernels
+{
+  // Distancia euclidiana al cuadrado entre dos vectores de n elementos
+  double l2sq(const double *a, const double *b, size_t n);
+  double l2sq(const float *a, const float *b, size_t n);
+
+  // Distancias de una muestra a 4 prototipos consecutivos, cuyas filas están
+  // separadas por `stride` elementos. Cada carga de `x` se reutiliza en los
+  // 4 prototipos; el resultado de cada uno es idéntico al de l2sq.
+  void l2sq_x4(const double *x, const double *w, size_t stride, size_t n, double out[4]);
+  void l2sq_x4(const float *x, const float *w, size_t stride, size_t n, double out[4]);
+
+  // Elementos por bloque en l2sq_bounded
+  constexpr size_t BOUNDED_BLOCK = 64;
+
+  // Distancia al cuadrado con abandono temprano (búsqueda por distancia
+  // parcial). Suma los bloques de BOUNDED_BLOCK elementos que empiezan en
+  // blocks[0..n_blocks), en ese orden (el último puede quedar cortado por n),
+  // y se detiene en cuanto la suma parcial supera `bound`: en ese caso el
+  // resultado es esa suma parcial (> bound). `evaluated` recibe el número de
+  // dimensiones sumadas. El orden de suma no es el de l2sq, así que la
+  // distancia completa puede diferir en los últimos bits.
+  double l2sq_bounded(const double *a, const double *b, const uint32_t *blocks, size_t n_blocks, size_t n,
+                      double bound, size_t &evaluated);
+  double l2sq_bounded(const float *a, const float *b, const uint32_t *blocks, size_t n_blocks, size_t n,
+                      double bound, size_t &evaluated);
+
+  // Producto punto de un vector disperso (nnz entradas: índices crecientes
+  // idx y valores val) con un vector denso w: sum_k val[k] * w[idx[k]]. Las
+  // variantes SIMD cargan w con instrucciones gather.
+  double sparse_dot(const uint32_t *idx, const double *val, size_t nnz, const double *w);
+  double sparse_dot(const uint32_t *idx, const float *val, size_t nnz, const float *w);
+
+  // y += a * x sobre n elementos
+  void axpy(double a, const double *x, size_t n, double *y);
+  void axpy(double a, const float *x, size_t n, float *y);
+
+  // w += a * (x - w) sobre n elementos, con w compartido por varios hilos
+  // sin bloqueos, y copia de los pesos nuevos en `local` (memoria propia del
+  // hilo). Cada peso compartido se lee y se escribe con un atomic_ref
+  // relajado: dos actualizaciones simultáneas pueden perder una de ellas, pero
+  // no hay carreras de datos. No tiene variantes SIMD: las cargas atómicas
+  // no se vectorizan, y pasar los elementos por un vector costaba más que el
+  // bucle escalar.
+  void lerp_shared(double a, const double *x, size_t n, double *w, double *local);
+  void lerp_shared(double a, const float *x, size_t n, float *w, float *local);
+
+  // Copia n pesos de w, que otros hilos escriben con lerp_shared, mediante
+  // lecturas atómicas relajadas
+  void load_shared(const double *w, size_t n, double *out);
+  void load_shared(const float *w, size_t n, float *out);
+
+  // Bloque de productos punto C = X * W^T, con X de m filas y W de nw filas
+  // (ambas de n elementos, separadas por ldx / ldw). C es fila-mayor con
+  // separación ldc. Usa un micro-kernel con bloqueo de registros. Con
+  // `accumulate` el resultado se suma a C en lugar de sobrescribirlo, de modo
+  // que los bloques de dimensiones sucesivos se acumulan en double.
+  void dot_nt(const double *X, size_t ldx, size_t m, const double *W, size_t ldw, size_t nw,
+              size_t n, double *C, size_t ldc, bool accumulate = false);
+  void dot_nt(const float *X, size_t ldx, size_t m, const float *W, size_t ldw, size_t nw,
+              size_t n, double *C, size_t ldc, bool accumulate = false);
+
+  // Convierte n valores de 8 bits al tipo de destino, multiplicados por `scale`
+  void widen_u8(const uint8_t *src, size_t n, double scale, double *dst);
+  void widen_u8(const uint8_t *src, size_t n, double scale, float *dst);
+
+  // Dimensiones de entrada con kernels de distancia especializados
+  constexpr size_t FIXED_DIMS[] = {64, 128, 256, 784};
+
+  // l2sq y l2sq_x4 para vectores de n elementos. Si n es una de FIXED_DIMS
+  // (y `specialize` es true), la longitud es una constante de compilación:
+  // los bucles se desenrollan por completo y el resto se resuelve al
+  // compilar. Con cualquier otra n son los kernels genéricos. El orden de
+  // suma es el mismo, así que las distancias son idénticas bit a bit.
+  template <typename E>
+  struct DimKernels
+  {
+    void (*one)(const E *, const E *, size_t, size_t, double *);
+    void (*four)(const E *, const E *, size_t, size_t, double *);
+    size_t n;
+    bool specialized;
+
+    double l2sq(const E *a, const E *b) const
+    {
+      double d;
+      one(a, b, 0, n, &d);
+      return d;
+    }
+
+    void l2sq_x4(const E *x, const E *w, size_t stride, double out[4]) const { four(x, w, stride, n, out); }
+  };
+
+  template <typename E>
+  DimKernels<E> for_dim(size_t n, bool specialize = true);
+
+  // Nombre de la implementación seleccionada
+  const char *isa_name();
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include "Checkpoint.hpp"
 #include <vector>
 #include <string>
 #include <fstream>
@@ -6,44 +7,30 @@
 #include <sstream>
 #include <stdexcept>
 
-std::vector<std::vector<double>> load_som_weights(const std::string& filename) {
+// Pesos de un checkpoint binario (ver Checkpoint.hpp), uno por neurona.
+// Usa el mismo cargador que el entrenamiento; `labels` recibe la etiqueta
+// asignada a cada neurona (-1 = sin etiquetar).
+inline std::vector<std::vector<double>> load_som_weights(const std::string& filename,
+                                                         std::vector<int>* labels = nullptr) {
     std::vector<std::vector<double>> all_weights;
-    std::ifstream in(filename, std::ios::binary);
-    
-    if (!in.is_open()) {
-        std::cerr << "Error: Could not open file " << filename << " for reading\n";
+    checkpoint::Data<double> data;
+    if (!checkpoint::load(filename, data)) {
         return all_weights;
     }
 
-    // Leer dimensiones
-    size_t num_neurons, weights_dim;
-    in.read(reinterpret_cast<char*>(&num_neurons), sizeof(num_neurons));
-    in.read(reinterpret_cast<char*>(&weights_dim), sizeof(weights_dim));
-
-    if (num_neurons == 0 || weights_dim == 0) {
-        std::cerr << "Error: Invalid file format or empty data\n";
-        return all_weights;
+    all_weights.reserve(data.weights.rows());
+    for (size_t i = 0; i < data.weights.rows(); ++i) {
+        const double* row = data.weights.row(i);
+        all_weights.emplace_back(row, row + data.weights.cols());
     }
-
-    // Reservar espacio
-    all_weights.resize(num_neurons, std::vector<double>(weights_dim));
-
-    // Leer todos los pesos
-    for (size_t i = 0; i < num_neurons; ++i) {
-        in.read(reinterpret_cast<char*>(all_weights[i].data()), weights_dim * sizeof(double));
-        
-        // Verificar si la lectura fue exitosa
-        if (in.gcount() != static_cast<std::streamsize>(weights_dim * sizeof(double))) {
-            std::cerr << "Error: Failed to read complete weight data for neuron " << i << "\n";
-            return {};
-        }
+    if (labels) {
+        *labels = std::move(data.labels);
     }
-
-    in.close();
     return all_weights;
 }
 
-std::vector<std::vector<double>> load_som_weights_txt(const std::string& filename) {
+// Pesos en el formato de texto anterior (CSV, una neurona por línea)
+inline std::vector<std::vector<double>> load_som_weights_txt(const std::string& filename) {
     std::vector<std::vector<double>> weights;
     std::ifstream file(filename);
     
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Matriz densa fila-mayor con almacenamiento contiguo alineado a 64 bytes.
+// Cada fila se rellena (con ceros) hasta un múltiplo de la línea de caché,
+// de modo que todas las filas empiezan alineadas y el prefetcher puede
+// recorrer la matriz completa de forma secuencial.
+template <typename T>
+class Matrix
+{
+public:
+  static constexpr size_t ALIGNMENT = 64;
+
+private:
+  size_t n_rows = 0;
+  size_t n_cols = 0;
+  size_t row_stride = 0;
+  T *ptr = nullptr;
+  std::shared_ptr<void> owner; // Mantiene vivo el almacenamiento
+
+  static size_t padded_stride(size_t cols)
+  {
+    constexpr size_t per_line = ALIGNMENT / sizeof(T);
+    return (cols + per_line - 1) / per_line * per_line;
+  }
+
+public:
+  Matrix() = default;
+
+  Matrix(size_t rows, size_t cols)
+      : n_rows(rows), n_cols(cols), row_stride(padded_stride(cols))
+  {
+    size_t bytes = n_rows * row_stride * sizeof(T);
+    if (bytes == 0)
+      return;
+
+    void *mem = std::aligned_alloc(ALIGNMENT, bytes);
+    if (!mem)
+      throw std::bad_alloc();
+    std::memset(mem, 0, bytes);
+    ptr = static_cast<T *>(mem);
+    owner.reset(mem, std::free);
+  }
+
+  // Copia profunda: el resultado siempre es dueño de su memoria (para
+  // compartir filas sin copiarlas se usa slice)
+  Matrix(const Matrix &other) : Matrix(other.n_rows, other.n_cols)
+  {
+    for (size_t i = 0; i < n_rows; ++i)
+      std::copy(other.row(i), other.row(i) + n_cols, row(i));
+  }
+
+  Matrix(Matrix &&other) noexcept
+      : n_rows(std::exchange(other.n_rows, 0)), n_cols(std::exchange(other.n_cols, 0)),
+        row_stride(std::exchange(other.row_stride, 0)), ptr(std::exchange(other.ptr, nullptr)),
+        owner(std::move(other.owner)) {}
+
+  Matrix &operator=(Matrix other) noexcept
+  {
+    std::swap(n_rows, other.n_rows);
+    std::swap(n_cols, other.n_cols);
+    std::swap(row_stride, other.row_stride);
+    std::swap(ptr, other.ptr);
+    std::swap(owner, other.owner);
+    return *this;
+  }
+
+  // Vista sobre memoria externa (p. ej. un archivo mapeado); `keeper` mantiene
+  // vivo el almacenamiento mientras exista alguna vista sobre él
+  static Matrix wrap(T *data, size_t rows, size_t cols, size_t stride, std::shared_ptr<void> keeper)
+  {
+    Matrix m;
+    m.n_rows = rows;
+    m.n_cols = cols;
+    m.row_stride = stride;
+    m.ptr = data;
+    m.owner = std::move(keeper);
+    return m;
+  }
+
+  // Vista de `count` filas a partir de `begin`, sin copiar (comparte almacenamiento)
+  Matrix slice(size_t begin, size_t count) const
+  {
+    return wrap(const_cast<T *>(row(begin)), count, n_cols, row_stride, owner);
+  }
+
+  // Construye la matriz a partir de filas independientes (formato de Reader)
+  template <typename U>
+  static Matrix from_rows(const std::vector<std::vector<U>> &rows)
+  {
+    size_t cols = rows.empty() ? 0 : rows[0].size();
+    Matrix m(rows.size(), cols);
+    for (size_t i = 0; i < rows.size(); ++i)
+      std::copy_n(rows[i].begin(), std::min(cols, rows[i].size()), m.row(i));
+    return m;
+  }
+
+  size_t rows() const { return n_rows; }
+  size_t cols() const { return n_cols; }
+  size_t stride() const { return row_stride; }
+  bool empty() const { return n_rows == 0; }
+
+  T *data() { return ptr; }
+  const T *data() const { return ptr; }
+  T *row(size_t i) { return ptr + i * row_stride; }
+  const T *row(size_t i) const { return ptr + i * row_stride; }
+};
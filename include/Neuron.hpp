@@ -1,49 +1,112 @@
 #pragma once
 
-#include <random>
+#include "Kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 
+// Vista ligera sobre una fila del codebook de RedKohonen.
+// No posee memoria: los pesos viven en la matriz contigua de la red.
+// T es el tipo escalar de los pesos (double o float).
+template <typename T>
 class Neuron
 {
 private:
-  std::vector<double> weights;
-  int label = -1; // -1 indica que no está etiquetada
+  T *weights = nullptr;
+  int n_inputs = 0;
 
 public:
   Neuron() = default;
 
-  Neuron(int n_inputs) : weights(n_inputs)
+  Neuron(T *w, int n) : weights(w), n_inputs(n) {}
+
+  // Distancia euclidiana al cuadrado (más eficiente)
+  double distance_sq(const T *input) const { return kernels::l2sq(input, weights, n_inputs); }
+
+  double distance_sq(const std::vector<T> &input) const { return distance_sq(input.data()); }
+
+  // Acerca los pesos a la entrada
+  void update_weights(const T *input, double learning_rate, double influence)
   {
-    // Inicialización aleatoria de pesos entre 0 y 1
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(0.0, 1.0);
+    T alpha = static_cast<T>(learning_rate * influence);
     for (int i = 0; i < n_inputs; ++i)
-    {
-      weights[i] = dis(gen);
-    }
+      weights[i] += alpha * (input[i] - weights[i]);
   }
 
-  // Distancia euclidiana al cuadrado (más eficiente)
-  double distance_sq(const std::vector<double> &input) const
+  void update_weights(const std::vector<T> &input, double learning_rate, double influence)
+  {
+    update_weights(input.data(), learning_rate, influence);
+  }
+
+  // Igual que update_weights, y además devuelve la distancia de los pesos
+  // nuevos a `reference` (la posición de la neurona en otro momento): el
+  // desplazamiento neto desde entonces. Solo la usa BmuSearch::BOUNDED, para
+  // que el resto de búsquedas no paguen esa distancia extra.
+  double update_weights_tracked(const T *input, double learning_rate, double influence, const T *reference)
   {
-    double d = 0.0;
-    for (size_t i = 0; i < input.size(); ++i)
+    update_weights(input, learning_rate, influence);
+    return std::sqrt(distance_sq(reference));
+  }
+
+  // Igual que update_weights, pero pensada para que varios hilos actualicen
+  // la misma neurona a la vez (TrainingAlgorithm::ASYNC). Dos actualizaciones
+  // simultáneas pueden pisarse peso a peso, como en Hogwild; cada peso se lee
+  // y se escribe de forma atómica, y los pesos nuevos se copian en `local`
+  // (ver kernels::lerp_shared).
+  void update_weights_relaxed(const T *input, double learning_rate, double influence, T *local)
+  {
+    kernels::lerp_shared(learning_rate * influence, input, n_inputs, weights, local);
+  }
+
+  // Actualización con una muestra dispersa (nnz entradas idx/val, norma
+  // x_sq) sin tocar las dimensiones en las que la muestra es cero. Los pesos
+  // reales son scale * weights, de modo que w' = (1 - a) w + a x se aplica como
+  //   scale' = (1 - a) scale,   weights[idx] += a val / scale'
+  // y norm_sq (||w||^2) se mantiene al día sin recorrer el vector:
+  //   ||w'||^2 = (1 - a)^2 ||w||^2 + 2 a (1 - a) x.w + a^2 ||x||^2
+  // x_dot_w es x.w con los pesos actuales (la búsqueda de la BMU ya lo
+  // calculó). Cuando la escala cae por debajo de min_scale se aplica a los pesos.
+  void update_weights_sparse(const uint32_t *idx, const T *val, size_t nnz, double x_sq, double x_dot_w,
+                             double learning_rate, double influence, double min_scale, double &scale, double &norm_sq)
+  {
+    const double a = learning_rate * influence;
+    const double keep = 1.0 - a;
+    if (keep <= 0.0)
+    {
+      // a >= 1: los pesos pasan a ser la muestra
+      std::fill(weights, weights + n_inputs, T(0));
+      for (size_t k = 0; k < nnz; ++k)
+        weights[idx[k]] = val[k];
+      scale = 1.0;
+      norm_sq = x_sq;
+      return;
+    }
+    if (keep * scale < min_scale)
     {
-      double diff = input[i] - weights[i];
-      d += diff * diff;
+      // Al recorrer todos los pesos se corrige también el error acumulado en norm_sq
+      apply_scale(scale);
+      kernels::dot_nt(weights, 0, 1, weights, 0, 1, n_inputs, &norm_sq, 1);
     }
-    return d;
+
+    scale *= keep;
+    const T coef = static_cast<T>(a / scale);
+    for (size_t k = 0; k < nnz; ++k)
+      weights[idx[k]] += coef * val[k];
+    norm_sq = std::max(0.0, keep * keep * norm_sq + 2.0 * a * keep * x_dot_w + a * a * x_sq);
   }
 
-  void update_weights(const std::vector<double> &input, double learning_rate, double influence)
+  // Multiplica los pesos por `scale` y la deja en 1
+  void apply_scale(double &scale)
   {
-    for (size_t i = 0; i < weights.size(); ++i)
-      weights[i] += learning_rate * influence * (input[i] - weights[i]);
+    if (scale == 1.0)
+      return;
+    const T s = static_cast<T>(scale);
+    for (int i = 0; i < n_inputs; ++i)
+      weights[i] *= s;
+    scale = 1.0;
   }
 
-  void set_label(int lbl) { label = lbl; }
-  int get_label() const { return label; }
-  const std::vector<double> &get_weights() const { return weights; }
-  void set_weights_from_load(const std::vector<double> &new_weights) { weights = new_weights; }
+  int size() const { return n_inputs; }
+  const T *get_weights() const { return weights; }
 };
@@ -1,9 +1,20 @@
 #pragma once
 
+#include "DatasetFormat.hpp"
+#include "Idx.hpp"
+#include "Matrix.hpp"
+#include "SparseMatrix.hpp"
+#include "Trace.hpp"
+#include <fcntl.h>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
 class Reader {
@@ -14,6 +25,7 @@ public:
                        int num_classes,
                        bool header = false,
                        size_t max_rows = 0) {
+    TRACE_SCOPE("load_csv");
     std::ifstream file(filename);
     if (!file.is_open()) {
       std::cerr << "Error: No se pudo abrir el archivo " << filename << std::endl;
@@ -63,4 +75,191 @@ public:
 
     file.close();
   }
+
+  // Igual que load_csv, pero X se guarda en formato CSR: de cada fila solo se
+  // conservan los valores no nulos (ver SparseMatrix.hpp)
+  template <typename T>
+  static void load_csv_sparse(const std::string &filename,
+                              SparseMatrix<T> &X,
+                              std::vector<std::vector<double>> &Y,
+                              int num_classes,
+                              bool header = false,
+                              size_t max_rows = 0) {
+    TRACE_SCOPE("load_csv_sparse");
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+      std::cerr << "Error: No se pudo abrir el archivo " << filename << std::endl;
+      return;
+    }
+
+    std::string line;
+    size_t row_count = 0;
+    std::vector<T> x_pixels;
+
+    if (header) {
+      std::getline(file, line);
+    }
+
+    while (std::getline(file, line)) {
+      if (max_rows > 0 && row_count >= max_rows)
+        break;
+
+      std::stringstream ss(line);
+      std::string token;
+      std::vector<double> row;
+
+      while (std::getline(ss, token, ',')) {
+        try {
+          row.push_back(std::stod(token));
+        } catch (const std::invalid_argument &ia) {
+          std::cerr << "Valor inválido en CSV: " << token << std::endl;
+          continue;
+        }
+      }
+
+      if (row.size() <= num_classes) {
+        std::cerr << "Fila inválida con " << row.size()
+                  << " columnas (esperado más de " << num_classes << ")." << std::endl;
+        continue;
+      }
+
+      size_t image_size = row.size() - num_classes;
+      if (X.empty())
+        X = SparseMatrix<T>(image_size);
+      if (image_size != X.cols()) {
+        std::cerr << "Fila inválida con " << image_size << " píxeles (esperado " << X.cols() << ")." << std::endl;
+        continue;
+      }
+
+      x_pixels.assign(row.begin(), row.begin() + image_size);
+      X.append(x_pixels.data());
+      Y.emplace_back(row.begin() + image_size, row.end());
+
+      row_count++;
+    }
+
+    file.close();
+  }
+
+  // Lee directamente los archivos IDX de MNIST. Los píxeles se conservan como
+  // uint8_t (filas alineadas, rellenas con ceros) y se escalan a [0,1] recién
+  // al llegar a los kernels de distancia. Y recibe el índice de clase.
+  static void load_idx(const std::string &image_file, const std::string &label_file,
+                       Matrix<uint8_t> &X, std::vector<int> &Y, size_t max_rows = 0) {
+    TRACE_SCOPE("load_idx");
+    std::ifstream images(image_file, std::ios::binary);
+    std::ifstream labels(label_file, std::ios::binary);
+    if (!images.is_open() || !labels.is_open()) {
+      std::cerr << "Error: No se pudo abrir " << (images.is_open() ? label_file : image_file) << std::endl;
+      return;
+    }
+
+    idx::Header image_header, label_header;
+    if (!idx::read_images_header(images, image_header) || !idx::read_labels_header(labels, label_header)) {
+      std::cerr << "Error: Cabecera IDX inválida en " << image_file << " / " << label_file << std::endl;
+      return;
+    }
+    if (image_header.count != label_header.count) {
+      std::cerr << "Error: " << image_file << " y " << label_file
+                << " no tienen el mismo número de ejemplos." << std::endl;
+      return;
+    }
+
+    size_t n = static_cast<size_t>(image_header.count);
+    if (max_rows > 0 && max_rows < n)
+      n = max_rows;
+    size_t image_size = static_cast<size_t>(image_header.rows) * image_header.cols;
+
+    Matrix<uint8_t> pixels(n, image_size);
+    for (size_t i = 0; i < n; ++i)
+      images.read(reinterpret_cast<char *>(pixels.row(i)), image_size);
+
+    std::vector<uint8_t> raw_labels(n);
+    labels.read(reinterpret_cast<char *>(raw_labels.data()), n);
+
+    if (!images || !labels) {
+      std::cerr << "Error: Archivo IDX truncado: " << image_file << std::endl;
+      return;
+    }
+
+    X = std::move(pixels);
+    Y.assign(raw_labels.begin(), raw_labels.end());
+  }
+
+  // Mapea un dataset binario (.kds, ver DatasetFormat.hpp) sin copiar las
+  // muestras: X queda como una vista sobre el archivo mapeado, que se libera
+  // cuando desaparece la última vista. Y recibe el índice de clase de cada fila.
+  template <typename T>
+  static void map_dataset(const std::string &filename, Matrix<T> &X, std::vector<int> &Y) {
+    using namespace dataset_format;
+    TRACE_SCOPE("map_dataset");
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      std::cerr << "Error: No se pudo abrir el archivo " << filename << std::endl;
+      return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+      std::cerr << "Error: Archivo de dataset vacío o truncado: " << filename << std::endl;
+      ::close(fd);
+      return;
+    }
+
+    // MAP_PRIVATE: las escrituras (si las hubiera) no llegan al archivo
+    size_t length = static_cast<size_t>(st.st_size);
+    void *base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+      std::cerr << "Error: No se pudo mapear el archivo " << filename << std::endl;
+      return;
+    }
+    std::shared_ptr<void> mapping(base, [length](void *p) { munmap(p, length); });
+    madvise(base, length, MADV_WILLNEED);
+
+    Header h;
+    std::memcpy(&h, base, sizeof(h));
+    size_t elem = dtype_size(static_cast<DType>(h.dtype));
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION) {
+      std::cerr << "Error: " << filename << " no es un dataset binario compatible." << std::endl;
+      return;
+    }
+    if (static_cast<DType>(h.dtype) != dtype_of<T>()) {
+      std::cerr << "Error: El tipo de dato de " << filename << " no coincide con el solicitado." << std::endl;
+      return;
+    }
+    bool has_labels = static_cast<LabelLayout>(h.label_layout) == LabelLayout::INDEX_INT32;
+    if (h.row_stride < h.dims || h.data_offset % alignof(T) != 0 ||
+        h.data_offset + h.rows * h.row_stride * elem > length ||
+        (has_labels && h.labels_offset + h.rows * sizeof(int32_t) > length)) {
+      std::cerr << "Error: Cabecera inconsistente en " << filename << std::endl;
+      return;
+    }
+
+    char *bytes = static_cast<char *>(base);
+    X = Matrix<T>::wrap(reinterpret_cast<T *>(bytes + h.data_offset), h.rows, h.dims, h.row_stride, mapping);
+    if (has_labels) {
+      const int32_t *labels = reinterpret_cast<const int32_t *>(bytes + h.labels_offset);
+      Y.assign(labels, labels + h.rows);
+    }
+  }
+
+  // Un split de MNIST: si existe el .kds de convert.cpp (uint8) lo mapea sin
+  // copia; si no existe o no se puede mapear, lee los IDX originales
+  static void load_mnist(const std::string &kds_file, const std::string &image_file, const std::string &label_file,
+                         Matrix<uint8_t> &X, std::vector<int> &Y) {
+    struct stat st;
+    if (::stat(kds_file.c_str(), &st) == 0) {
+      map_dataset(kds_file, X, Y);
+      if (!X.empty() && Y.size() == X.rows()) {
+        std::cout << "Dataset mapeado desde " << kds_file << std::endl;
+        return;
+      }
+      std::cerr << "Se usan los archivos IDX en su lugar." << std::endl;
+      X = Matrix<uint8_t>();
+      Y.clear();
+    }
+    load_idx(image_file, label_file, X, Y);
+  }
 };
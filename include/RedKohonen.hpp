@@ -1,7 +1,18 @@
 #pragma once
 
+#include "Checkpoint.hpp"
+#include "Kernels.hpp"
+#include "Matrix.hpp"
 #include "Neuron.hpp"
+#include "SampleStream.hpp"
+#include "Samples.hpp"
+#include "SparseMatrix.hpp"
+#include <cmath>
+#include <limits>
+#include <random>
+#include <span>
 #include <tuple>
+#include <variant>
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -13,7 +24,37 @@ enum class NeighborhoodMode
   CONSTANT_RADIUS  // Vecinos con influencia constante dentro del radio
 };
 
-class RedKohonen
+enum class TrainingAlgorithm
+{
+  ONLINE,    // Actualiza los pesos tras cada muestra
+  BATCH,     // Recalcula cada prototipo una vez por época (SOM por lotes)
+  ASYNC,     // Online, con cada hilo procesando sus propias muestras sin bloqueos (estilo Hogwild)
+  MINI_BATCH // Online por bloques de B muestras, reproducible bit a bit con cualquier número de hilos
+};
+
+enum class BmuSearch
+{
+  EXACT,            // Recorre todo el codebook para cada muestra
+  CACHED_LOCAL,     // Busca primero alrededor de la BMU de la época anterior (aproximado, solo ONLINE)
+  PARTIAL_DISTANCE, // Recorre todo el codebook abandonando cada distancia al superar la mejor (exacto)
+  BOUNDED           // Descarta la búsqueda con cotas de desigualdad triangular (exacto, solo ONLINE)
+};
+
+// Resultado de BasicRedKohonen::evaluate: con una sola búsqueda de BMUs se
+// etiquetan las neuronas y se miden la precisión y el error de cuantización
+// (distancia media de cada muestra a su BMU)
+struct Evaluation
+{
+  float accuracy = 0.0f;
+  double quantization_error = 0.0;
+};
+
+// Red de Kohonen con pesos de tipo escalar T (double o float). Con float los
+// kernels procesan el doble de elementos por registro y el codebook ocupa la
+// mitad; las sumas que acumulan muchos términos (SOM por lotes, normas y
+// productos punto por bloques) se hacen en double.
+template <typename T>
+class BasicRedKohonen
 {
 private:
   int dim_x, dim_y, dim_z;
@@ -24,48 +65,291 @@ private:
   double time_constant;
   double initial_radius;
 
-  std::vector<Neuron> neurons;
-  std::vector<std::vector<double>> X_val_data;
+  Matrix<T> codebook;       // total_neurons x input_dim, filas alineadas
+  kernels::DimKernels<T> distance_kernels; // l2sq especializados si input_dim es una de kernels::FIXED_DIMS
+  std::vector<int> labels;  // Etiqueta de cada neurona (-1 = sin etiquetar)
+  std::vector<double> prototype_norms; // ||w||^2 de cada neurona, para find_bmu_batch
+  std::variant<Matrix<T>, Matrix<uint8_t>, SparseMatrix<T>> X_val_data;
   std::vector<int> Y_val_labels;
 
+  double influence_epsilon = 1e-4;     // Influencias menores se truncan a 0
+  std::vector<double> influence_table; // Influencia por distancia al cuadrado en la malla
+  int influence_reach = 0;             // Desplazamiento máximo por eje con influencia > 0
+
+  checkpoint::State train_state; // Última época entrenada, se guarda en los checkpoints
+  size_t train_distances = 0;    // Distancias muestra-neurona calculadas en las épocas entrenadas
+
   bool validation_enabled = false;
   NeighborhoodMode mode = NeighborhoodMode::GAUSSIAN_RADIUS;
+  TrainingAlgorithm algorithm = TrainingAlgorithm::ONLINE;
+
+  BmuSearch bmu_search = BmuSearch::EXACT;
+  int cache_window = 2;         // Semiancho (por eje) de la ventana de búsqueda local
+  int mini_batch_size = 256;    // Muestras por bloque con TrainingAlgorithm::MINI_BATCH
+  int checkpoint_interval = 5;  // train_test guarda checkpoint.dat cada tantas épocas
+
+  // Evaluación asíncrona en train_test (ver set_async_evaluation). Mientras
+  // dura, train deja en deferred_line el informe de la época sin validar.
+  bool async_evaluation = false;
+  int evaluation_threads = 1;
+  bool defer_evaluation = false;
+  std::string deferred_line;
+
+  // BMU de una muestra de entrenamiento en la última época
+  struct CachedBmu
+  {
+    int index = -1; // -1 = sin BMU cacheada
+    double dist = 0.0;
+  };
+  std::vector<CachedBmu> bmu_cache; // Una entrada por muestra de entrenamiento
+
+  // Inicio de cada bloque de kernels::BOUNDED_BLOCK dimensiones, en el orden
+  // en que los suma PARTIAL_DISTANCE (varianza de los datos decreciente)
+  std::vector<uint32_t> block_order;
+  bool block_order_from_data = false;
+
+  // Cotas de BmuSearch::BOUNDED. Los desplazamientos son netos (distancia
+  // de cada neurona a su posición en un codebook de referencia), no la suma
+  // de los pasos: en el SOM online cada neurona oscila alrededor de su
+  // posición y la suma de pasos crece sin límite.
+  //
+  // Cota de una muestra: su BMU la última vez que se buscó y una cota
+  // inferior de la distancia (no al cuadrado) a cualquier otra neurona, medida
+  // respecto al codebook de referencia de la época `epoch`.
+  struct SampleBound
+  {
+    int bmu = -1; // -1 = sin cotas
+    double lower = 0.0;
+    int epoch = -1;
+  };
+  std::vector<SampleBound> sample_bounds; // Una por muestra de entrenamiento
+  std::vector<SampleBound> val_bounds;    // Una por muestra de validación (respecto a eval_reference)
+  Matrix<T> reference;                    // Codebook al empezar la época
+  Matrix<T> eval_reference;               // Codebook en la última validación
+  std::vector<double> drift;              // ||w - reference|| de cada neurona
+  std::vector<double> nearest_prototype;  // Distancia a la neurona más cercana en `reference`
+  double epoch_drift = 0.0;               // Mayor valor de `drift` en la época en curso
+  double last_epoch_drift = 0.0;          // El de la época anterior: acota cuánto cambió `reference`
+
+  // Escala diferida de cada neurona durante el entrenamiento online con
+  // muestras dispersas: los pesos reales son weight_scale[i] * codebook.row(i)
+  // (ver Neuron::update_weights_sparse). Vacío fuera de ese entrenamiento.
+  std::vector<double> weight_scale;
+  std::vector<double> sample_dot; // x.w de la muestra en curso con cada neurona
 
-  int find_bmu(const std::vector<double> &input) const;
+  // Estadísticas de búsqueda de BMUs de una época de entrenamiento online
+  struct SearchStats
+  {
+    size_t cache_hits = 0;
+    size_t distances = 0; // Distancias calculadas por PARTIAL_DISTANCE
+    size_t dims = 0;      // Dimensiones sumadas en esas distancias
+    size_t pruned = 0;    // Búsquedas descartadas por las cotas de BOUNDED
+    size_t evaluated = 0; // Distancias muestra-neurona calculadas (completas o abandonadas)
+  };
+
+  // Candidato a BMU de un rango de neuronas (alineado para evitar false sharing)
+  struct alignas(64) BmuCandidate
+  {
+    double dist = std::numeric_limits<double>::max();
+    int index = 0;
+    double second = std::numeric_limits<double>::max(); // Segunda mejor distancia del rango
+  };
+
+  int find_bmu(const std::vector<T> &input) const;
+  static BmuCandidate reduce_candidates(const BmuCandidate *slot, int n);
+  BmuCandidate find_bmu_in_range(const T *x, int begin, int end) const;
+  BmuCandidate find_bmu_in_rows(const Matrix<T> &W, const T *x, int begin, int end) const;
+  BmuCandidate find_bmu_sparse(const typename SparseMatrix<T>::Row &x, int begin, int end);
+  BmuCandidate find_bmu_partial(const T *x, int begin, int end, int hint, size_t &dims) const;
+  BmuCandidate find_bmu_in_window(const T *x, int center, int begin, int end, size_t &evaluated) const;
+  bool interior_of_window(int idx, int center) const;
+  void reset_block_order();
+  template <typename S>
+  void build_block_order(const Matrix<S> &X_train);
+  void build_nearest_prototypes();
+  void reset_bounds();
+  template <typename S>
+  size_t find_val_bmus(const Matrix<S> &X_val, std::vector<int> &bmus);
+  float accuracy_from(const std::vector<int> &bmus, const std::vector<int> &Y) const;
+  Evaluation evaluate_bmus(std::span<const int> bmus, std::span<const double> dist_sq, const std::vector<int> &Y);
+  template <typename F>
+  void for_each_neighbor(int bmu_idx, int begin, int end, F &&update) const;
+  double update_neighborhood(const T *x, int bmu_idx, double current_lr, int begin, int end);
+  void update_neighborhood_sparse(const typename SparseMatrix<T>::Row &x, int bmu_idx, double current_lr,
+                                  double min_scale, int begin, int end);
+  double neighborhood_influence(double dist_sq, double radius_sq) const;
+  void refresh_norms();
+  void build_influence_table(double radius_sq);
+  template <typename S>
+  SearchStats train_online(int epoch, const Matrix<S> &X_train, double current_lr);
+  SearchStats train_online(int epoch, const SparseMatrix<T> &X_train, double current_lr);
+  template <typename S>
+  void train_async(int epoch, const Matrix<S> &X_train, double current_lr);
+  template <typename S>
+  void train_mini_batch(int epoch, const Matrix<S> &X_train, double current_lr);
+  template <typename Samples>
+  void train_batch(const Samples &X_train);
+  void report_epoch(int epoch, double duration, BmuSearch search, const SearchStats &stats, size_t n_samples,
+                    std::ofstream *log_file);
+  template <typename F, typename Samples>
+  void run_epochs(F &&train_epoch, const Samples &X_test, const std::vector<int> &Y_test,
+                  const std::string &weights_filename);
+  template <typename Samples>
+  void accumulate_batch(const Samples &X_train, Matrix<double> &sums, std::span<double> counts) const;
+  void smooth_batch(const Matrix<double> &sums, std::span<const double> counts, int begin, int end);
+  checkpoint::State epoch_schedule(int epoch) const;
+
+  // Distancia al cuadrado de x a la neurona i con los kernels de input_dim
+  double distance_to(int i, const T *x) const { return distance_kernels.l2sq(x, codebook.row(i)); }
+
+  std::tuple<int, int, int> lattice_coords(int idx) const
+  {
+    return {idx % dim_x, (idx % (dim_x * dim_y)) / dim_x, idx / (dim_x * dim_y)};
+  }
 
 public:
-  RedKohonen(int inputDim, int dX, int dY, int dZ, double initialLR = 0.0, int numEpochs = 0,
-             NeighborhoodMode mode_ = NeighborhoodMode::GAUSSIAN_RADIUS)
+  BasicRedKohonen(int inputDim, int dX, int dY, int dZ, double initialLR = 0.0, int numEpochs = 0,
+             NeighborhoodMode mode_ = NeighborhoodMode::GAUSSIAN_RADIUS,
+             TrainingAlgorithm algorithm_ = TrainingAlgorithm::ONLINE, double startRadius = 0.0)
       : input_dim(inputDim), dim_x(dX), dim_y(dY), dim_z(dZ),
-        initial_learning_rate(initialLR), epochs(numEpochs), mode(mode_)
+        initial_learning_rate(initialLR), epochs(numEpochs), mode(mode_), algorithm(algorithm_)
   {
     total_neurons = dim_x * dim_y * dim_z;
-    neurons.reserve(total_neurons);
-    for (int i = 0; i < total_neurons; ++i)
-      neurons.emplace_back(initialLR > 0 ? Neuron(input_dim) : Neuron());
+    codebook = Matrix<T>(total_neurons, input_dim);
+    distance_kernels = kernels::for_dim<T>(input_dim);
+    labels.assign(total_neurons, -1);
 
+    if (initialLR > 0)
+    {
+      // Inicialización aleatoria de pesos entre 0 y 1
+      std::random_device rd;
+      std::mt19937 gen(rd());
+      std::uniform_real_distribution<> dis(0.0, 1.0);
+      for (int i = 0; i < total_neurons; ++i)
+      {
+        T *w = codebook.row(i);
+        for (int j = 0; j < input_dim; ++j)
+          w[j] = static_cast<T>(dis(gen));
+      }
+    }
+
+    // Sin startRadius (o con uno <= 1) el radio parte de la mitad de la malla
     if (numEpochs > 0)
     {
-      initial_radius = std::max({dim_x, dim_y, dim_z}) / 2.0;
+      initial_radius = startRadius > 1.0 ? startRadius : std::max({dim_x, dim_y, dim_z}) / 2.0;
       time_constant = epochs / log(initial_radius);
     }
+    refresh_norms();
+    reset_block_order();
+    reset_bounds();
   }
 
+  // Entrenamiento de grueso a fino: red de dX x dY x dZ cuyo codebook es el
+  // de `coarse` interpolado trilinealmente en el espacio de la malla (las
+  // esquinas de ambas mallas coinciden). El radio parte de start_radius, que
+  // debe ser menor que la mitad de la malla porque el orden global ya viene de
+  // `coarse`. Modo y algoritmo se heredan de `coarse`.
+  BasicRedKohonen(const BasicRedKohonen &coarse, int dX, int dY, int dZ, double initialLR, int numEpochs,
+                  double start_radius);
+
+  // Los métodos que reciben una Matrix aceptan muestras de tipo T o uint8_t
+  // (ver Samples.hpp); las de 8 bits se escalan a [0,1] al vuelo. Los que
+  // reciben `Samples` aceptan además muestras dispersas (SparseMatrix<T>),
+  // cuyos kernels solo recorren las dimensiones no nulas. Con muestras
+  // dispersas el entrenamiento online siempre hace la búsqueda exacta.
+  template <typename Samples>
+  Evaluation evaluate(const Samples &X_val, const std::vector<int> &Y_val);
+  template <typename Samples>
+  void assign_labels(const Samples &X_val, const std::vector<int> &Y_val);
   void assign_labels(const std::vector<std::vector<double>> &X_val, const std::vector<int> &Y_val);
+  template <typename S>
+  void set_validation_data(Matrix<S> X_val, const std::vector<int> &Y_val);
+  void set_validation_data(SparseMatrix<T> X_val, const std::vector<int> &Y_val);
   void set_validation_data(const std::vector<std::vector<double>> &X_val, const std::vector<int> &Y_val);
-  int predict(const std::vector<double> &x) const;
-  std::pair<int, std::tuple<int, int, int>> predict_with_coords(const std::vector<double> &x) const;
-  std::tuple<int, int, int> find_bmu_coords(const std::vector<double> &input) const;
+  int predict(const std::vector<T> &x) const;
+  std::pair<int, std::tuple<int, int, int>> predict_with_coords(const std::vector<T> &x) const;
+  std::tuple<int, int, int> find_bmu_coords(const std::vector<T> &input) const;
+  template <typename S>
+  void find_bmu_batch(const Matrix<S> &X, std::span<int> out, std::span<double> dist_sq = {}) const;
+  void find_bmu_batch(const SparseMatrix<T> &X, std::span<int> out, std::span<double> dist_sq = {}) const;
+  template <typename Samples>
+  void train(int epoch, const Samples &X_train, std::ofstream *log_file);
   void train(int epoch, const std::vector<std::vector<double>> &X_train, std::ofstream *log_file);
+  template <typename Samples>
+  float test_accuracy(const Samples &X_test, const std::vector<int> &Y_test) const;
   float test_accuracy(const std::vector<std::vector<double>> &X_test, const std::vector<int> &Y_test) const;
+  template <typename Samples>
+  void train_test(const Samples &X_train, const Samples &X_test,
+                  const std::vector<int> &Y_test, const std::string &weights_filename = "base");
   void train_test(const std::vector<std::vector<double>> &X_train,
                   const std::vector<std::vector<double>> &X_test,
                   const std::vector<int> &Y_test, const std::string &weights_filename = "base");
+  // Entrenamiento fuera de memoria: cada época recorre el flujo una vez,
+  // bloque a bloque (ver SampleStream.hpp), con búsqueda de BMU exacta. La
+  // validación y el test siguen en memoria.
+  template <typename S>
+  void train(int epoch, SampleStream<S> &stream, std::ofstream *log_file);
+  template <typename S>
+  void train_test(SampleStream<S> &train_stream, const Matrix<S> &X_test, const std::vector<int> &Y_test,
+                  const std::string &weights_filename = "base");
+  // Checkpoint binario (ver Checkpoint.hpp): pesos, etiquetas y estado del
+  // entrenamiento. Tras load_weights, train_test continúa desde la época
+  // siguiente a la guardada.
   void save_weights(const std::string &filename) const;
   void load_weights(const std::string &filename);
+  // Igual, con un checkpoint ya cargado (sin volver a leer el fichero).
+  // Devuelve false si su dimensión de entrada no es la de la red.
+  bool load_weights(checkpoint::Data<T> data);
 
-  const std::vector<Neuron> &get_neurons() const { return neurons; }
+  // SOM por lotes repartido entre procesos (ver shard.cpp). En cada época
+  // cada proceso acumula con batch_partials las sumas S_j y los conteos n_j
+  // de su fragmento de muestras (sums y counts deben llegar en cero); una vez
+  // reducidos los parciales de todos, batch_update recalcula los prototipos
+  // de [begin, end). Con attach_codebook los pesos pasan a vivir en
+  // `storage` (p. ej. memoria compartida); con publish se copian allí los
+  // actuales, si no se adoptan los que ya contiene.
+  template <typename Samples>
+  void batch_partials(int epoch, const Samples &X_shard, Matrix<double> &sums, std::span<double> counts);
+  void batch_update(const Matrix<double> &sums, std::span<const double> counts, int begin, int end);
+  void attach_codebook(Matrix<T> storage, bool publish);
+  // Recalcula lo que depende de los pesos (normas, cachés de búsqueda) tras
+  // modificarlos desde fuera de la red
+  void refresh_codebook();
+
+  Neuron<T> neuron(int i) { return Neuron<T>(codebook.row(i), input_dim); }
+  const Neuron<T> neuron(int i) const { return Neuron<T>(const_cast<T *>(codebook.row(i)), input_dim); }
+  void set_influence_epsilon(double eps) { influence_epsilon = eps; }
+  // La caché de BMUs y las cotas se asocian al conjunto de entrenamiento por
+  // índice de muestra; se reinician si cambia el número de muestras
+  void set_bmu_search(BmuSearch search, int window = 2)
+  {
+    bmu_search = search;
+    cache_window = std::max(1, window);
+    bmu_cache.clear();
+    reset_bounds();
+  }
+  void set_mini_batch_size(int size) { mini_batch_size = std::max(1, size); }
+  void set_checkpoint_interval(int epochs) { checkpoint_interval = std::max(1, epochs); }
+  int get_checkpoint_interval() const { return checkpoint_interval; }
+  // Con false la búsqueda usa los kernels genéricos aunque input_dim tenga
+  // versión especializada (para compararlos); el resultado no cambia
+  void set_fixed_dim_kernels(bool enabled) { distance_kernels = kernels::for_dim<T>(input_dim, enabled); }
+  bool fixed_dim_kernels() const { return distance_kernels.specialized; }
+  // Con la evaluación asíncrona, train_test valida, mide el test y guarda los
+  // checkpoints de cada época sobre una copia del codebook, con `threads`
+  // hilos de OpenMP, mientras se entrena la época siguiente
+  void set_async_evaluation(bool enabled, int threads = 1)
+  {
+    async_evaluation = enabled;
+    evaluation_threads = std::max(1, threads);
+  }
+  const Matrix<T> &get_codebook() const { return codebook; }
+  const std::vector<int> &get_labels() const { return labels; }
+  const checkpoint::State &get_train_state() const { return train_state; }
+  size_t get_train_distances() const { return train_distances; }
   int get_dim_x() const { return dim_x; }
   int get_dim_y() const { return dim_y; }
   int get_dim_z() const { return dim_z; }
 };
+
+using RedKohonen = BasicRedKohonen<double>;
@@ -0,0 +1,482 @@
+#pragma once
+
+#include "DatasetFormat.hpp"
+#include "Idx.hpp"
+#include "Matrix.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Entrenamiento fuera de memoria: las muestras se leen del disco por bloques
+// de tamaño fijo mientras la red entrena con el bloque anterior.
+//
+// - ChunkSource<S>: lector de un formato (CSV, .kds o IDX). Lee las filas en
+//   orden, a partir de `first` y como mucho `count` (0 = hasta el final), así
+//   que un mismo archivo puede dar el conjunto de entrenamiento y el de
+//   validación sin copiarse.
+// - SampleStream<S>: doble buffer sobre una fuente. Un hilo propio llena el
+//   bloque siguiente mientras se consume el actual; la memoria es la de dos
+//   bloques sea cual sea el tamaño del dataset. Opcionalmente baraja las
+//   filas de cada bloque (con una semilla fija, distinta en cada pasada).
+//
+// S es el tipo de las muestras tal como las acepta la red (T o uint8_t, ver
+// Samples.hpp).
+
+template <typename S>
+class ChunkSource
+{
+protected:
+  size_t n_dims = 0;
+  size_t n_rows = 0; // Filas del rango (0 si no se conocen sin leer el archivo)
+  bool valid = false;
+
+public:
+  virtual ~ChunkSource() = default;
+
+  bool ok() const { return valid; }
+  size_t dims() const { return n_dims; }
+  size_t rows() const { return n_rows; }
+
+  // Vuelve a la primera fila del rango
+  virtual void rewind() = 0;
+  // Lee hasta X.rows() filas en X (y su clase en Y); devuelve cuántas leyó,
+  // 0 al terminar el rango o ante un error
+  virtual size_t read(Matrix<S> &X, std::vector<int> &Y) = 0;
+};
+
+// CSV con el formato de Reader::load_csv: los píxeles y después num_classes
+// columnas one-hot. La clase es la columna one-hot mayor.
+template <typename T>
+class CsvSource : public ChunkSource<T>
+{
+  std::ifstream file;
+  std::string filename;
+  int num_classes;
+  bool header;
+  size_t first, count;
+  size_t position = 0; // Filas leídas del rango
+  std::vector<double> row;
+
+  // Convierte una línea en `row`; false si no tiene el número de columnas esperado
+  bool parse(const std::string &line)
+  {
+    row.clear();
+    const char *p = line.c_str();
+    while (*p)
+    {
+      char *end;
+      double value = std::strtod(p, &end);
+      if (end == p)
+        return false;
+      row.push_back(value);
+      if (*end == ',')
+        p = end + 1;
+      else if (*end == '\0' || *end == '\r')
+        break;
+      else
+        return false;
+    }
+    return row.size() > static_cast<size_t>(num_classes);
+  }
+
+public:
+  CsvSource(const std::string &filename_, int num_classes_, bool header_ = false, size_t first_ = 0,
+            size_t count_ = 0)
+      : file(filename_), filename(filename_), num_classes(num_classes_), header(header_), first(first_), count(count_)
+  {
+    if (!file.is_open())
+    {
+      std::cerr << "Error: No se pudo abrir el archivo " << filename << std::endl;
+      return;
+    }
+
+    // La dimensión sale de la primera fila de datos
+    std::string line;
+    if (header)
+      std::getline(file, line);
+    if (!std::getline(file, line) || !parse(line))
+    {
+      std::cerr << "Error: " << filename << " no tiene filas válidas." << std::endl;
+      return;
+    }
+    this->n_dims = row.size() - num_classes;
+    this->valid = true;
+    rewind();
+  }
+
+  void rewind() override
+  {
+    file.clear();
+    file.seekg(0);
+    std::string line;
+    if (header)
+      std::getline(file, line);
+    for (size_t i = 0; i < first && std::getline(file, line); ++i)
+      ;
+    position = 0;
+  }
+
+  size_t read(Matrix<T> &X, std::vector<int> &Y) override
+  {
+    TRACE_SCOPE("csv_chunk");
+    const size_t dims = this->n_dims;
+    size_t n = 0;
+    std::string line;
+    while (n < X.rows() && (count == 0 || position < count) && std::getline(file, line))
+    {
+      position++;
+      if (!parse(line) || row.size() - num_classes != dims)
+      {
+        std::cerr << "Fila inválida con " << row.size() << " columnas (esperado " << dims + num_classes << ")."
+                  << std::endl;
+        continue;
+      }
+
+      std::copy(row.begin(), row.begin() + dims, X.row(n));
+      Y[n] = static_cast<int>(std::max_element(row.begin() + dims, row.end()) - (row.begin() + dims));
+      n++;
+    }
+    return n;
+  }
+};
+
+// Dataset binario (.kds, ver DatasetFormat.hpp) leído con pread. Las filas del
+// archivo tienen el mismo relleno que Matrix, así que un bloque completo se
+// lee con una sola llamada.
+template <typename T>
+class KdsSource : public ChunkSource<T>
+{
+  int fd = -1;
+  std::string filename;
+  dataset_format::Header h{};
+  size_t first, end = 0;
+  size_t position = 0;
+  bool has_labels = false;
+
+public:
+  KdsSource(const std::string &filename_, size_t first_ = 0, size_t count_ = 0)
+      : filename(filename_), first(first_)
+  {
+    using namespace dataset_format;
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      std::cerr << "Error: No se pudo abrir el archivo " << filename << std::endl;
+      return;
+    }
+    if (::pread(fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h)) ||
+        std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION)
+    {
+      std::cerr << "Error: " << filename << " no es un dataset binario compatible." << std::endl;
+      return;
+    }
+    if (static_cast<DType>(h.dtype) != dtype_of<T>())
+    {
+      std::cerr << "Error: El tipo de dato de " << filename << " no coincide con el solicitado." << std::endl;
+      return;
+    }
+    if (h.row_stride < h.dims)
+    {
+      std::cerr << "Error: Cabecera inconsistente en " << filename << std::endl;
+      return;
+    }
+
+    has_labels = static_cast<LabelLayout>(h.label_layout) == LabelLayout::INDEX_INT32;
+    first = std::min<size_t>(first, h.rows);
+    end = count_ == 0 ? h.rows : std::min<size_t>(h.rows, first + count_);
+    position = first;
+    this->n_dims = h.dims;
+    this->n_rows = end - first;
+    this->valid = true;
+  }
+
+  ~KdsSource() override
+  {
+    if (fd >= 0)
+      ::close(fd);
+  }
+  KdsSource(const KdsSource &) = delete;
+  KdsSource &operator=(const KdsSource &) = delete;
+
+  void rewind() override { position = first; }
+
+  size_t read(Matrix<T> &X, std::vector<int> &Y) override
+  {
+    TRACE_SCOPE("kds_chunk");
+    const size_t n = std::min(X.rows(), end - position);
+    if (n == 0)
+      return 0;
+
+    const size_t row_bytes = h.row_stride * sizeof(T);
+    const off_t offset = static_cast<off_t>(h.data_offset + position * row_bytes);
+    bool complete = true;
+    if (X.stride() == h.row_stride)
+      complete = read_all(X.data(), n * row_bytes, offset);
+    else
+      for (size_t i = 0; i < n && complete; ++i)
+        complete = read_all(X.row(i), X.cols() * sizeof(T), offset + static_cast<off_t>(i * row_bytes));
+
+    if (has_labels)
+    {
+      std::vector<int32_t> labels(n);
+      complete = complete && read_all(labels.data(), n * sizeof(int32_t),
+                                      static_cast<off_t>(h.labels_offset + position * sizeof(int32_t)));
+      std::copy(labels.begin(), labels.end(), Y.begin());
+    }
+    else
+      std::fill(Y.begin(), Y.begin() + n, -1);
+
+    if (!complete)
+    {
+      std::cerr << "Error: Archivo de dataset truncado: " << filename << std::endl;
+      position = end;
+      return 0;
+    }
+    position += n;
+    return n;
+  }
+
+private:
+  bool read_all(void *dst, size_t bytes, off_t offset) const
+  {
+    char *p = static_cast<char *>(dst);
+    while (bytes > 0)
+    {
+      ssize_t got = ::pread(fd, p, bytes, offset);
+      if (got <= 0)
+        return false;
+      p += got;
+      bytes -= static_cast<size_t>(got);
+      offset += got;
+    }
+    return true;
+  }
+};
+
+// Archivos IDX de MNIST (imágenes y etiquetas), con los píxeles como uint8_t
+class IdxSource : public ChunkSource<uint8_t>
+{
+  std::ifstream images, labels;
+  std::string image_file;
+  size_t first, end = 0;
+  size_t position = 0;
+  static constexpr std::streamoff IMAGES_OFFSET = 16; // Tamaño de las cabeceras
+  static constexpr std::streamoff LABELS_OFFSET = 8;
+
+public:
+  IdxSource(const std::string &image_file_, const std::string &label_file, size_t first_ = 0, size_t count_ = 0)
+      : images(image_file_, std::ios::binary), labels(label_file, std::ios::binary), image_file(image_file_),
+        first(first_)
+  {
+    if (!images.is_open() || !labels.is_open())
+    {
+      std::cerr << "Error: No se pudo abrir " << (images.is_open() ? label_file : image_file) << std::endl;
+      return;
+    }
+    idx::Header image_header, label_header;
+    if (!idx::read_images_header(images, image_header) || !idx::read_labels_header(labels, label_header))
+    {
+      std::cerr << "Error: Cabecera IDX inválida en " << image_file << " / " << label_file << std::endl;
+      return;
+    }
+    if (image_header.count != label_header.count)
+    {
+      std::cerr << "Error: " << image_file << " y " << label_file << " no tienen el mismo número de ejemplos."
+                << std::endl;
+      return;
+    }
+
+    const size_t total = static_cast<size_t>(image_header.count);
+    first = std::min(first, total);
+    end = count_ == 0 ? total : std::min(total, first + count_);
+    n_dims = static_cast<size_t>(image_header.rows) * image_header.cols;
+    n_rows = end - first;
+    valid = true;
+    rewind();
+  }
+
+  void rewind() override
+  {
+    images.clear();
+    labels.clear();
+    images.seekg(IMAGES_OFFSET + static_cast<std::streamoff>(first * n_dims));
+    labels.seekg(LABELS_OFFSET + static_cast<std::streamoff>(first));
+    position = first;
+  }
+
+  size_t read(Matrix<uint8_t> &X, std::vector<int> &Y) override
+  {
+    TRACE_SCOPE("idx_chunk");
+    const size_t n = std::min(X.rows(), end - position);
+    std::vector<uint8_t> raw_labels(n);
+    for (size_t i = 0; i < n; ++i)
+      images.read(reinterpret_cast<char *>(X.row(i)), n_dims);
+    labels.read(reinterpret_cast<char *>(raw_labels.data()), n);
+    if (!images || !labels)
+    {
+      std::cerr << "Error: Archivo IDX truncado: " << image_file << std::endl;
+      position = end;
+      return 0;
+    }
+    std::copy(raw_labels.begin(), raw_labels.end(), Y.begin());
+    position += n;
+    return n;
+  }
+};
+
+// Bloque de muestras listo para entrenar: X es una vista de n filas sobre el
+// buffer del flujo y Y tiene la clase de cada una
+template <typename S>
+struct SampleChunk
+{
+  Matrix<S> X;
+  std::vector<int> Y;
+};
+
+template <typename S>
+class SampleStream
+{
+  std::unique_ptr<ChunkSource<S>> source;
+  Matrix<S> storage[2];
+  SampleChunk<S> chunks[2];
+  bool shuffle;
+  std::mt19937_64 gen;
+
+  // Los bloques se llenan y se consumen alternando 0, 1, 0, 1... El cargador
+  // puede llenar el bloque `produced` mientras produced - released < 2.
+  std::mutex mtx;
+  std::condition_variable cv;
+  uint64_t produced = 0, consumed = 0, released = 0;
+  bool holding = false;       // El consumidor tiene el bloque consumed - 1
+  bool pass_done = true;      // No hay más bloques en la pasada en curso
+  bool rewind_requested = false;
+  bool stopping = false;
+  std::thread loader;
+
+  void shuffle_rows(SampleChunk<S> &chunk)
+  {
+    const size_t n = chunk.X.rows();
+    for (size_t i = n; i > 1; --i)
+    {
+      size_t j = std::uniform_int_distribution<size_t>(0, i - 1)(gen);
+      if (j == i - 1)
+        continue;
+      std::swap_ranges(chunk.X.row(i - 1), chunk.X.row(i - 1) + chunk.X.cols(), chunk.X.row(j));
+      std::swap(chunk.Y[i - 1], chunk.Y[j]);
+    }
+  }
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true)
+    {
+      cv.wait(lock, [this]
+              { return stopping || rewind_requested || (!pass_done && produced - released < 2); });
+      if (stopping)
+        return;
+      if (rewind_requested)
+      {
+        source->rewind();
+        produced = consumed = released = 0;
+        holding = false;
+        pass_done = false;
+        rewind_requested = false;
+        cv.notify_all();
+        continue;
+      }
+
+      // La lectura se hace sin el cerrojo: el consumidor sigue con su bloque
+      const int slot = static_cast<int>(produced % 2);
+      lock.unlock();
+      SampleChunk<S> &chunk = chunks[slot];
+      chunk.Y.resize(storage[slot].rows());
+      size_t n = source->read(storage[slot], chunk.Y);
+      chunk.X = storage[slot].slice(0, n);
+      chunk.Y.resize(n);
+      if (shuffle && n > 0)
+        shuffle_rows(chunk);
+      lock.lock();
+
+      if (n == 0)
+        pass_done = true;
+      else
+        produced++;
+      cv.notify_all();
+    }
+  }
+
+public:
+  SampleStream(std::unique_ptr<ChunkSource<S>> source_, size_t chunk_rows, bool shuffle_ = false,
+               uint64_t seed = 42)
+      : source(std::move(source_)), shuffle(shuffle_), gen(seed)
+  {
+    if (!source || !source->ok())
+      return;
+    for (auto &buffer : storage)
+      buffer = Matrix<S>(std::max<size_t>(1, chunk_rows), source->dims());
+    loader = std::thread([this] { run(); });
+  }
+
+  ~SampleStream()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stopping = true;
+    }
+    cv.notify_all();
+    if (loader.joinable())
+      loader.join();
+  }
+  SampleStream(const SampleStream &) = delete;
+  SampleStream &operator=(const SampleStream &) = delete;
+
+  bool ok() const { return source && source->ok(); }
+  size_t dims() const { return source ? source->dims() : 0; }
+  size_t chunk_rows() const { return storage[0].rows(); }
+
+  // Empieza una pasada desde la primera fila; el cargador comienza a leer el
+  // primer bloque enseguida. Invalida el bloque devuelto por next().
+  void rewind()
+  {
+    if (!ok())
+      return;
+    std::unique_lock<std::mutex> lock(mtx);
+    rewind_requested = true;
+    cv.notify_all();
+    cv.wait(lock, [this] { return !rewind_requested; });
+  }
+
+  // Siguiente bloque de la pasada (nullptr al terminarla). Sigue siendo
+  // válido hasta la próxima llamada a next() o rewind().
+  const SampleChunk<S> *next()
+  {
+    if (!ok())
+      return nullptr;
+    std::unique_lock<std::mutex> lock(mtx);
+    if (holding)
+    {
+      released++;
+      holding = false;
+      cv.notify_all();
+    }
+    cv.wait(lock, [this] { return produced > consumed || pass_done; });
+    if (produced == consumed)
+      return nullptr;
+    holding = true;
+    return &chunks[consumed++ % 2];
+  }
+};
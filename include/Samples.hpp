@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Kernels.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Tipos de muestra que acepta la red. Las muestras se guardan en su tipo
+// nativo y se convierten al tipo escalar T de la red (double o float) justo
+// antes de los kernels de distancia.
+//
+// - T: se usan tal cual, sin copia.
+// - uint8_t: intensidades de 8 bits (IDX de MNIST), escaladas a [0, 1].
+constexpr double PIXEL_SCALE = 1.0 / 255.0;
+
+// Devuelve la muestra en el tipo T; `buffer` (de al menos n elementos) solo se
+// usa cuando hace falta convertir
+template <typename T>
+const T *decode_sample(const T *x, size_t, T *)
+{
+  return x;
+}
+
+template <typename T>
+const T *decode_sample(const uint8_t *x, size_t n, T *buffer)
+{
+  kernels::widen_u8(x, n, PIXEL_SCALE, buffer);
+  return buffer;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "DatasetFormat.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Protocolo binario de KohonenServe sobre un socket Unix (SOCK_STREAM).
+// Cada petición es una trama:
+//
+//   [RequestHeader de 24 bytes][count * dims muestras de tipo dtype]
+//
+// sin relleno entre muestras, y cada respuesta:
+//
+//   [ReplyHeader de 16 bytes][count Prediction]
+//
+// Una conexión puede enviar varias peticiones seguidas; las respuestas llegan
+// en el mismo orden, con el `id` de su petición. Una petición inválida recibe
+// una respuesta con el status del error y el servidor cierra la conexión.
+// Los enteros van en el orden de bytes nativo (el cliente y el servidor están
+// en la misma máquina).
+namespace serve
+{
+  constexpr char REQUEST_MAGIC[4] = {'K', 'S', 'R', 'Q'};
+  constexpr char REPLY_MAGIC[4] = {'K', 'S', 'R', 'P'};
+  constexpr const char *DEFAULT_SOCKET = "/tmp/kohonen.sock";
+  constexpr uint32_t MAX_REQUEST_SAMPLES = 4096;
+
+  enum class Status : int32_t
+  {
+    OK = 0,
+    BAD_DTYPE = 1, // dtype distinto de UINT8 / FLOAT32
+    BAD_DIMS = 2,  // dims no coincide con la entrada de la red
+    TOO_MANY = 3,  // count mayor que MAX_REQUEST_SAMPLES
+    BAD_FRAME = 4  // magic incorrecto: el resto de la cabecera no es fiable
+  };
+
+  struct RequestHeader
+  {
+    char magic[4];
+    uint32_t id;    // Lo elige el cliente; se devuelve en la respuesta
+    uint32_t count; // Muestras en la petición
+    uint32_t dims;  // Elementos por muestra
+    uint32_t dtype; // dataset_format::DType (UINT8 escalado a [0,1], o FLOAT32)
+    uint32_t reserved;
+  };
+  static_assert(sizeof(RequestHeader) == 24, "la cabecera de petición debe ocupar 24 bytes");
+
+  struct ReplyHeader
+  {
+    char magic[4];
+    uint32_t id;
+    uint32_t count; // Predicciones que siguen (0 si status != OK)
+    int32_t status; // Status
+  };
+  static_assert(sizeof(ReplyHeader) == 16, "la cabecera de respuesta debe ocupar 16 bytes");
+
+  struct Prediction
+  {
+    int32_t label;   // Etiqueta de la BMU (-1 = sin etiquetar)
+    int32_t x, y, z; // Coordenadas de la BMU en la malla
+    float distance;  // Error de cuantización: ||x - w_bmu||
+  };
+  static_assert(sizeof(Prediction) == 20, "cada predicción debe ocupar 20 bytes");
+
+  // Lee o escribe exactamente n bytes (reintenta lecturas parciales y EINTR).
+  // Devuelve false si la conexión se cerró o hubo un error.
+  inline bool read_full(int fd, void *data, size_t n)
+  {
+    char *p = static_cast<char *>(data);
+    while (n > 0)
+    {
+      ssize_t got = ::read(fd, p, n);
+      if (got < 0 && errno == EINTR)
+        continue;
+      if (got <= 0)
+        return false;
+      p += got;
+      n -= static_cast<size_t>(got);
+    }
+    return true;
+  }
+
+  inline bool write_full(int fd, const void *data, size_t n)
+  {
+    const char *p = static_cast<const char *>(data);
+    while (n > 0)
+    {
+      ssize_t sent = ::send(fd, p, n, MSG_NOSIGNAL);
+      if (sent < 0 && errno == EINTR)
+        continue;
+      if (sent <= 0)
+        return false;
+      p += sent;
+      n -= static_cast<size_t>(sent);
+    }
+    return true;
+  }
+
+  // Como write_full, pero sin bloquear más de timeout_ms en total: si el otro
+  // extremo no lee y el buffer del socket sigue lleno, devuelve false
+  inline bool write_full_timeout(int fd, const void *data, size_t n, int timeout_ms)
+  {
+    const char *p = static_cast<const char *>(data);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (n > 0)
+    {
+      ssize_t sent = ::send(fd, p, n, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (sent > 0)
+      {
+        p += sent;
+        n -= static_cast<size_t>(sent);
+        continue;
+      }
+      if (sent < 0 && errno == EINTR)
+        continue;
+      if (sent == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        return false;
+
+      const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0)
+        return false;
+      pollfd writable{fd, POLLOUT, 0};
+      if (::poll(&writable, 1, static_cast<int>(left.count())) < 0 && errno != EINTR)
+        return false;
+    }
+    return true;
+  }
+
+  // Dirección de un socket Unix; false si la ruta no cabe
+  inline bool make_address(const std::string &path, sockaddr_un &addr)
+  {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+      return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+  }
+}
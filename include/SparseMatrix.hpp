@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Matrix.hpp"
+#include "Samples.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Muestras dispersas en formato CSR (compressed sparse row). De cada fila se
+// guardan solo los índices y valores no nulos, ya convertidos al tipo escalar
+// T de la red, y su norma al cuadrado. En MNIST alrededor del 80% de los
+// píxeles son exactamente cero, así que los kernels dispersos recorren unas
+// 150 dimensiones por muestra en lugar de 784.
+template <typename T>
+class SparseMatrix
+{
+private:
+  size_t n_cols = 0;
+  std::vector<size_t> offsets{0}; // Entradas de la fila i: [offsets[i], offsets[i + 1])
+  std::vector<uint32_t> indices;  // Columna de cada entrada, creciente dentro de la fila
+  std::vector<T> values;
+  std::vector<double> norms; // ||x||^2 de cada fila
+
+public:
+  // Vista sobre una fila
+  struct Row
+  {
+    const uint32_t *idx;
+    const T *val;
+    size_t nnz;
+    double norm_sq;
+  };
+
+  SparseMatrix() = default;
+
+  explicit SparseMatrix(size_t cols) : n_cols(cols) {}
+
+  // Añade una fila a partir de sus cols() valores densos, descartando los ceros
+  void append(const T *dense)
+  {
+    double norm = 0.0;
+    for (size_t j = 0; j < n_cols; ++j)
+    {
+      if (dense[j] != T(0))
+      {
+        indices.push_back(static_cast<uint32_t>(j));
+        values.push_back(dense[j]);
+        norm += static_cast<double>(dense[j]) * dense[j];
+      }
+    }
+    offsets.push_back(indices.size());
+    norms.push_back(norm);
+  }
+
+  // Comprime una matriz densa de muestras de tipo T o uint8_t (ver Samples.hpp)
+  template <typename S>
+  static SparseMatrix from_dense(const Matrix<S> &X)
+  {
+    SparseMatrix m(X.cols());
+    m.offsets.reserve(X.rows() + 1);
+    m.norms.reserve(X.rows());
+    Matrix<T> buffer(1, X.cols());
+    for (size_t i = 0; i < X.rows(); ++i)
+      m.append(decode_sample(X.row(i), X.cols(), buffer.data()));
+    return m;
+  }
+
+  size_t rows() const { return norms.size(); }
+  size_t cols() const { return n_cols; }
+  size_t nnz() const { return indices.size(); }
+  bool empty() const { return norms.empty(); }
+
+  // Fracción de entradas no nulas
+  double density() const { return empty() || n_cols == 0 ? 0.0 : static_cast<double>(nnz()) / (rows() * n_cols); }
+
+  Row row(size_t i) const
+  {
+    const size_t from = offsets[i];
+    return {indices.data() + from, values.data() + from, offsets[i + 1] - from, norms[i]};
+  }
+};
+
+template <typename X>
+inline constexpr bool is_sparse_v = false;
+
+template <typename T>
+inline constexpr bool is_sparse_v<SparseMatrix<T>> = true;
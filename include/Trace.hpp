@@ -0,0 +1,154 @@
+#pragma once
+
+// Instrumentación por fases (se activa con la opción de CMake KOHONEN_TRACING).
+//
+// - TRACE_SCOPE("fase"): mide el bloque que lo contiene y lo registra como un
+//   evento en el buffer circular del hilo.
+// - TRACE_COUNT(CONTADOR, n): suma n a un contador del hilo (distancias
+//   calculadas, neuronas actualizadas...).
+// - TRACE_LAP_BEGIN(lap) / TRACE_LAP(lap, CONTADOR): reparte el tiempo de un
+//   bucle caliente entre varios contadores de nanosegundos sin generar un
+//   evento por iteración.
+// - TRACE_EPOCH(e) / TRACE_EPOCH_END(e): delimitan una época; los eventos se
+//   atribuyen a la época en curso y los contadores se cierran al terminarla.
+// - TRACE_SESSION_BEGIN(dir) / TRACE_SESSION_END(): un hilo aparte vacía los
+//   buffers en dir/trace.json (formato Chrome trace-event, se abre en
+//   chrome://tracing o Perfetto) y al final escribe dir/trace_summary.txt
+//   con el tiempo de cada fase y los contadores por época.
+//
+// Sin KOHONEN_TRACING todas las macros se expanden a ((void)0) y no queda
+// ningún rastro en el código generado.
+
+#ifdef KOHONEN_TRACING
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace trace
+{
+  enum class Counter
+  {
+    DISTANCES,       // Distancias muestra-neurona evaluadas
+    NEURONS_UPDATED, // Neuronas actualizadas en el entrenamiento online
+    SEARCH_NS,       // Búsqueda de BMU en el bucle online (suma de hilos)
+    SYNC_NS,         // Barrera y reducción de candidatos (suma de hilos)
+    UPDATE_NS,       // Actualización de la vecindad (suma de hilos)
+    COUNT
+  };
+
+  struct Event
+  {
+    const char *name; // Literal: vive todo el programa
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    int32_t epoch;
+  };
+
+  // Buffer circular de un hilo: solo él escribe (head) y solo el hilo de
+  // volcado lee (tail). Si se llena, los eventos nuevos se descartan y se cuentan.
+  struct ThreadBuffer
+  {
+    static constexpr size_t CAPACITY = 4096;
+    uint32_t tid = 0;
+    std::array<Event, CAPACITY> events;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::COUNT)> counters{};
+
+    void push(const Event &e)
+    {
+      uint64_t h = head.load(std::memory_order_relaxed);
+      if (h - tail.load(std::memory_order_acquire) == CAPACITY)
+      {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+      }
+      events[h % CAPACITY] = e;
+      head.store(h + 1, std::memory_order_release);
+    }
+  };
+
+  ThreadBuffer *register_thread();
+  extern std::atomic<int32_t> current_epoch;
+
+  inline ThreadBuffer *local_buffer()
+  {
+    static thread_local ThreadBuffer *buffer = register_thread();
+    return buffer;
+  }
+
+  // Nanosegundos desde el inicio del programa
+  inline uint64_t now_ns()
+  {
+    static const auto origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+  }
+
+  // Solo el hilo dueño escribe sus contadores: basta load + store relajados
+  inline void add(Counter c, uint64_t n)
+  {
+    std::atomic<uint64_t> &value = local_buffer()->counters[static_cast<size_t>(c)];
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  class Scope
+  {
+    const char *name;
+    uint64_t start;
+
+  public:
+    explicit Scope(const char *name_) : name(name_), start(now_ns()) {}
+    ~Scope()
+    {
+      uint64_t end = now_ns();
+      local_buffer()->push({name, start, end - start, current_epoch.load(std::memory_order_relaxed)});
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+  struct Lap
+  {
+    uint64_t last = now_ns();
+
+    void split(Counter c)
+    {
+      uint64_t t = now_ns();
+      add(c, t - last);
+      last = t;
+    }
+  };
+
+  void begin_epoch(int epoch);
+  void end_epoch(int epoch);
+  void begin_session(const std::string &dir);
+  void end_session();
+}
+
+#define KOHONEN_TRACE_CONCAT2(a, b) a##b
+#define KOHONEN_TRACE_CONCAT(a, b) KOHONEN_TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) trace::Scope KOHONEN_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_COUNT(counter, n) trace::add(trace::Counter::counter, (n))
+#define TRACE_LAP_BEGIN(lap) trace::Lap lap
+#define TRACE_LAP(lap, counter) lap.split(trace::Counter::counter)
+#define TRACE_EPOCH(epoch) trace::begin_epoch(epoch)
+#define TRACE_EPOCH_END(epoch) trace::end_epoch(epoch)
+#define TRACE_SESSION_BEGIN(dir) trace::begin_session(dir)
+#define TRACE_SESSION_END() trace::end_session()
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNT(counter, n) ((void)0)
+#define TRACE_LAP_BEGIN(lap) ((void)0)
+#define TRACE_LAP(lap, counter) ((void)0)
+#define TRACE_EPOCH(epoch) ((void)0)
+#define TRACE_EPOCH_END(epoch) ((void)0)
+#define TRACE_SESSION_BEGIN(dir) ((void)0)
+#define TRACE_SESSION_END() ((void)0)
+
+#endif
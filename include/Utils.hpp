@@ -1,11 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <iomanip>
 #include <iostream>
 
+#if defined(__SSE__) || defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
+
 using namespace std;
 
 // Cronometro
@@ -27,4 +41,97 @@ inline double stop_timer(const TimePoint& start_time) {
 // Imprime duracion en segundos con formato
 inline void print_duration(double duration, const string& label) {
     cout << label << ": " << fixed << setprecision(2) << duration << " s" << endl;
-}
\ No newline at end of file
+}
+
+// Percentil p (entre 0 y 1) de `values`, que quedan parcialmente reordenados
+inline double percentile(vector<double>& values, double p) {
+    if (values.empty())
+        return 0.0;
+    size_t k = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+// Convierte un argumento de línea de comandos a número. Devuelve false si el
+// texto está vacío, le sobran caracteres o el valor no cabe en T.
+template <typename T>
+bool parse_number(const char* text, T& value) {
+    char* end = nullptr;
+    errno = 0;
+    if constexpr (is_floating_point_v<T>) {
+        double v = strtod(text, &end);
+        if (end == text || *end != '\0' || errno != 0)
+            return false;
+        value = static_cast<T>(v);
+    } else {
+        long long v = strtoll(text, &end, 10);
+        if (end == text || *end != '\0' || errno != 0)
+            return false;
+        if (v < 0 ? (is_unsigned_v<T> || v < static_cast<long long>(numeric_limits<T>::min()))
+                  : static_cast<unsigned long long>(v) > static_cast<unsigned long long>(numeric_limits<T>::max()))
+            return false;
+        value = static_cast<T>(v);
+    }
+    return true;
+}
+
+// Activa flush-to-zero y denormals-are-zero en el hilo actual mientras viva
+// el objeto, y al destruirse restaura el MXCSR anterior. Los pesos que
+// decaen hacia entradas nulas (p. ej. los bordes de MNIST) terminan siendo
+// subnormales, y cada operación con ellos cuesta decenas de ciclos. Se crea al
+// principio de cada región paralela del entrenamiento: los hilos del pool de
+// OpenMP y el que llama recuperan su modo al salir de ella.
+class FlushToZero {
+#if defined(__SSE__) || defined(__x86_64__)
+    unsigned int saved = _mm_getcsr();
+
+public:
+    FlushToZero() { _mm_setcsr(saved | 0x8040); } // FTZ (bit 15) | DAZ (bit 6)
+    ~FlushToZero() { _mm_setcsr(saved); }
+#else
+public:
+    FlushToZero() = default;
+#endif
+    FlushToZero(const FlushToZero&) = delete;
+    FlushToZero& operator=(const FlushToZero&) = delete;
+};
+
+// Progreso de un bucle largo, impreso desde un hilo propio cada `period`.
+// El bucle solo publica su contador con update(), sin tocar std::cout.
+class ProgressReporter {
+    string label;
+    size_t total;
+    atomic<size_t> done{0};
+    bool running = true;
+    mutex mtx;
+    condition_variable stop_cv;
+    thread printer;
+
+    void print() const {
+        cout << label << ": " << done.load(memory_order_relaxed) << "/" << total << "\r";
+        cout.flush();
+    }
+
+public:
+    ProgressReporter(string label_, size_t total_,
+                     chrono::milliseconds period = chrono::milliseconds(250))
+        : label(std::move(label_)), total(total_) {
+        printer = thread([this, period] {
+            unique_lock<mutex> lock(mtx);
+            while (!stop_cv.wait_for(lock, period, [this] { return !running; }))
+                print();
+        });
+    }
+
+    ~ProgressReporter() {
+        {
+            lock_guard<mutex> lock(mtx);
+            running = false;
+        }
+        stop_cv.notify_one();
+        printer.join();
+        print();
+    }
+
+    void update(size_t count) { done.store(count, memory_order_relaxed); }
+};
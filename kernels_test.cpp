@@ -0,0 +1,249 @@
+// Comprueba los kernels de Kernels.hpp contra bucles escalares de referencia
+// (en long double). CTest lo ejecuta una vez por implementación con
+// KOHONEN_ISA; si la CPU no la admite, el despacho cae en la siguiente y la
+// prueba sigue siendo válida.
+//
+// Uso: KohonenKernelsTest   (KOHONEN_ISA=avx512|avx2|sse2|scalar)
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Kernels.hpp"
+#include "Matrix.hpp"
+#include "Samples.hpp"
+
+using namespace std;
+
+namespace
+{
+    int failures = 0;
+
+    // Error relativo respecto a la referencia (absoluto cerca de 0)
+    void check(const string &what, double got, long double expected, double tolerance)
+    {
+        const long double scale = max<long double>(1.0L, fabsl(expected));
+        if (!(fabsl(got - expected) / scale <= tolerance))
+        {
+            cerr << "FALLO " << what << ": " << got << " != " << static_cast<double>(expected) << endl;
+            failures++;
+        }
+    }
+
+    template <typename E>
+    long double ref_l2sq(const E *a, const E *b, size_t n)
+    {
+        long double d = 0.0L;
+        for (size_t i = 0; i < n; ++i)
+        {
+            long double diff = static_cast<long double>(a[i]) - b[i];
+            d += diff * diff;
+        }
+        return d;
+    }
+
+    template <typename E>
+    long double ref_dot(const E *a, const E *b, size_t n)
+    {
+        long double d = 0.0L;
+        for (size_t i = 0; i < n; ++i)
+            d += static_cast<long double>(a[i]) * b[i];
+        return d;
+    }
+
+    // Filas de n elementos con ~20% de ceros, como las imágenes de MNIST
+    template <typename E>
+    Matrix<E> random_rows(size_t rows, size_t n, mt19937 &gen)
+    {
+        uniform_real_distribution<double> value(0.0, 1.0);
+        bernoulli_distribution zero(0.2);
+        Matrix<E> M(rows, n);
+        for (size_t r = 0; r < rows; ++r)
+            for (size_t j = 0; j < n; ++j)
+                M.row(r)[j] = zero(gen) ? E(0) : static_cast<E>(value(gen));
+        return M;
+    }
+
+    template <typename E>
+    void test_distances(const string &type, size_t n, const Matrix<E> &X, const Matrix<E> &W, double tolerance)
+    {
+        const string tag = type + " n=" + to_string(n);
+        const E *x = X.row(0);
+
+        for (size_t r = 0; r < W.rows(); ++r)
+            check("l2sq " + tag, kernels::l2sq(x, W.row(r), n), ref_l2sq(x, W.row(r), n), tolerance);
+
+        // Filas separadas por el stride alineado de la matriz
+        double out[4];
+        kernels::l2sq_x4(x, W.row(0), W.stride(), n, out);
+        for (int k = 0; k < 4; ++k)
+            check("l2sq_x4 " + tag, out[k], ref_l2sq(x, W.row(k), n), tolerance);
+
+        // Especializados por dimensión: idénticos bit a bit a los genéricos
+        const kernels::DimKernels<E> fixed = kernels::for_dim<E>(n);
+        double generic[4];
+        fixed.l2sq_x4(x, W.row(0), W.stride(), out);
+        kernels::l2sq_x4(x, W.row(0), W.stride(), n, generic);
+        for (int k = 0; k < 4; ++k)
+            check("for_dim l2sq_x4 " + tag, out[k], generic[k], 0.0);
+        check("for_dim l2sq " + tag, fixed.l2sq(x, W.row(1)), kernels::l2sq(x, W.row(1), n), 0.0);
+
+        // dot_nt con bordes en filas y columnas, sobrescribiendo y acumulando
+        const size_t m = X.rows(), nw = W.rows();
+        vector<double> C(m * nw, 1.0);
+        for (bool accumulate : {false, true})
+        {
+            kernels::dot_nt(X.row(0), X.stride(), m, W.row(0), W.stride(), nw, n, C.data(), nw, accumulate);
+            for (size_t a = 0; a < m; ++a)
+                for (size_t b = 0; b < nw; ++b)
+                {
+                    long double expected = ref_dot(X.row(a), W.row(b), n) * (accumulate ? 2 : 1);
+                    check("dot_nt " + tag + (accumulate ? " (acumulado)" : ""), C[a * nw + b], expected, tolerance);
+                }
+        }
+    }
+
+    // l2sq_bounded con los bloques en orden inverso (el bloque cortado va
+    // primero): sin cota suma todo; con una cota intermedia se detiene justo en
+    // el bloque cuya suma parcial la supera
+    template <typename E>
+    void test_bounded(const string &tag, const E *x, const E *w, size_t n, double tolerance)
+    {
+        vector<uint32_t> blocks;
+        for (size_t from = 0; from < n; from += kernels::BOUNDED_BLOCK)
+            blocks.insert(blocks.begin(), static_cast<uint32_t>(from));
+        vector<long double> prefix;
+        size_t heaviest = 0;
+        long double sum = 0.0L, heaviest_sum = -1.0L;
+        for (size_t b = 0; b < blocks.size(); ++b)
+        {
+            const size_t from = blocks[b], len = min(kernels::BOUNDED_BLOCK, n - from);
+            const long double block = ref_l2sq(x + from, w + from, len);
+            sum += block;
+            prefix.push_back(sum);
+            if (block > heaviest_sum)
+                heaviest = b, heaviest_sum = block;
+        }
+
+        size_t evaluated = 0;
+        double d = kernels::l2sq_bounded(x, w, blocks.data(), blocks.size(), n, HUGE_VAL, evaluated);
+        check("l2sq_bounded sin cota " + tag, d, sum, tolerance);
+        check("l2sq_bounded sin cota, dimensiones " + tag, evaluated, n, 0.0);
+
+        // Cota a mitad del bloque más pesado: el abandono llega en ese bloque
+        const long double before = heaviest > 0 ? prefix[heaviest - 1] : 0.0L;
+        const double bound = static_cast<double>((before + prefix[heaviest]) / 2);
+        size_t expected_dims = 0;
+        for (size_t b = 0; b <= heaviest; ++b)
+            expected_dims += min(kernels::BOUNDED_BLOCK, n - blocks[b]);
+        d = kernels::l2sq_bounded(x, w, blocks.data(), blocks.size(), n, bound, evaluated);
+        check("l2sq_bounded con cota " + tag, d, prefix[heaviest], tolerance);
+        check("l2sq_bounded con cota, dimensiones " + tag, evaluated, expected_dims, 0.0);
+        if (prefix[heaviest] > 0.0L && !(d > bound))
+        {
+            cerr << "FALLO l2sq_bounded con cota " << tag << ": " << d << " no supera " << bound << endl;
+            failures++;
+        }
+    }
+
+    // axpy, lerp_shared y load_shared frente a la fórmula elemento a elemento
+    template <typename E>
+    void test_updates(const string &tag, const E *x, const E *w, size_t n, double tolerance)
+    {
+        const double a = 0.37;
+        vector<E> y(w, w + n);
+        kernels::axpy(a, x, n, y.data());
+        for (size_t i = 0; i < n; ++i)
+            check("axpy " + tag, y[i], w[i] + static_cast<long double>(static_cast<E>(a)) * x[i], tolerance);
+
+        vector<E> shared(w, w + n), local(n), loaded(n);
+        kernels::lerp_shared(a, x, n, shared.data(), local.data());
+        kernels::load_shared(shared.data(), n, loaded.data());
+        for (size_t i = 0; i < n; ++i)
+        {
+            const long double current = w[i];
+            check("lerp_shared " + tag, shared[i], current + static_cast<E>(a) * (x[i] - current), tolerance);
+            check("lerp_shared copia local " + tag, local[i], shared[i], 0.0);
+            check("load_shared " + tag, loaded[i], shared[i], 0.0);
+        }
+    }
+
+    // sparse_dot con nnz índices crecientes sobre un vector denso de n
+    // elementos (nnz = 0 debe dar 0 sin leer nada)
+    template <typename E>
+    void test_sparse(const string &type, size_t nnz, size_t n, mt19937 &gen, double tolerance)
+    {
+        vector<uint32_t> idx(n);
+        for (size_t i = 0; i < n; ++i)
+            idx[i] = static_cast<uint32_t>(i);
+        shuffle(idx.begin(), idx.end(), gen);
+        idx.resize(nnz);
+        sort(idx.begin(), idx.end());
+
+        uniform_real_distribution<double> value(0.0, 1.0);
+        vector<E> val(nnz), w(n);
+        for (E &v : val)
+            v = static_cast<E>(value(gen));
+        for (E &v : w)
+            v = static_cast<E>(value(gen));
+
+        long double expected = 0.0L;
+        for (size_t k = 0; k < nnz; ++k)
+            expected += static_cast<long double>(val[k]) * w[idx[k]];
+        check("sparse_dot " + type + " nnz=" + to_string(nnz), kernels::sparse_dot(idx.data(), val.data(), nnz, w.data()),
+              expected, tolerance);
+    }
+
+    template <typename E>
+    void test_type(const string &type, size_t n, mt19937 &gen, double tolerance)
+    {
+        Matrix<E> X = random_rows<E>(5, n, gen);
+        Matrix<E> W = random_rows<E>(7, n, gen);
+        test_distances(type, n, X, W, tolerance);
+        test_bounded(type + " n=" + to_string(n), X.row(0), W.row(0), n, tolerance);
+        test_updates(type + " n=" + to_string(n), X.row(1), W.row(1), n, tolerance);
+
+        // Muestras de 8 bits: las variantes SIMD escalan en E (con float puede
+        // diferir en el último bit) y las distancias coinciden con las de la
+        // muestra ya convertida
+        uniform_int_distribution<int> pixel(0, 255);
+        vector<uint8_t> raw(n);
+        for (uint8_t &p : raw)
+            p = static_cast<uint8_t>(pixel(gen));
+        vector<E> buffer(n);
+        const E *decoded = decode_sample(raw.data(), n, buffer.data());
+        for (size_t i = 0; i < n; ++i)
+            check("widen_u8 " + type + " n=" + to_string(n), decoded[i], raw[i] * PIXEL_SCALE, tolerance);
+        Matrix<E> U(5, n);
+        for (size_t r = 0; r < U.rows(); ++r)
+            copy(decoded, decoded + n, U.row(r));
+        test_distances("uint8->" + type, n, U, W, tolerance);
+    }
+}
+
+int main()
+{
+    cout << "Kernels: " << kernels::isa_name() << endl;
+    mt19937 gen(7);
+    for (size_t n : {1, 7, 63, 64, 65, 128, 256, 784})
+    {
+        test_type<double>("double", n, gen, 1e-12);
+        test_type<float>("float", n, gen, 1e-5);
+    }
+    for (size_t nnz : {0, 1, 7, 17, 784})
+    {
+        test_sparse<double>("double", nnz, 784, gen, 1e-12);
+        test_sparse<float>("float", nnz, 784, gen, 1e-5);
+    }
+
+    if (failures > 0)
+    {
+        cerr << failures << " comprobaciones fallidas" << endl;
+        return 1;
+    }
+    cout << "OK" << endl;
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "Reader.hpp"
@@ -7,19 +8,6 @@
 
 using namespace std;
 
-// Función para convertir etiquetas de one-hot a entero
-vector<int> onehot_to_labels(const vector<vector<double>> &Y_onehot)
-{
-  vector<int> labels;
-  labels.reserve(Y_onehot.size());
-  for (const auto &row : Y_onehot)
-  {
-    auto max_it = max_element(row.begin(), row.end());
-    labels.push_back(distance(row.begin(), max_it));
-  }
-  return labels;
-}
-
 int main(int argc, char **argv)
 {
   // --- PARÁMETROS CONFIGURABLES ---
@@ -31,11 +19,39 @@ int main(int argc, char **argv)
   const int INPUT_DIM = 784;            // 28x28 pixeles
   const double VALIDATION_SPLIT = 0.20; // 20% para validación
   const string WEIGHTS_FILENAME = "mnist_gaussian_radius";
+  const NeighborhoodMode MODE = NeighborhoodMode::GAUSSIAN_RADIUS;
+  const TrainingAlgorithm ALGORITHM = TrainingAlgorithm::ONLINE; // ONLINE, BATCH, ASYNC (online sin barreras entre hilos) o MINI_BATCH
+  const int MINI_BATCH_SIZE = 256;                                // Muestras por bloque con MINI_BATCH
+  const BmuSearch BMU_SEARCH = BmuSearch::EXACT; // CACHED_LOCAL (aproximada), PARTIAL_DISTANCE o BOUNDED (exactas), solo ONLINE
+  using Real = double; // Tipo de los pesos; float es más rápido (el doble de elementos por registro SIMD) y ocupa la mitad
+  const bool SPARSE_INPUT = false; // Muestras en formato CSR: los kernels solo recorren los píxeles no nulos
+  const size_t STREAM_CHUNK = 0;   // > 0: el entrenamiento se lee del disco en bloques de N muestras (fuera de memoria)
+  const bool ASYNC_EVALUATION = false; // true: validación, test y checkpoints de cada época en paralelo con la siguiente
+  const int COARSE_DIM = 0; // > 0: entrena antes una malla de COARSE_DIM^3 y la interpola a DIM_X x DIM_Y x DIM_Z
+  const int COARSE_EPOCHS = 3; // Épocas de la malla gruesa
+  const double FINE_LEARNING_RATE = 0.1; // Tasa inicial de la malla fina cuando parte de la gruesa
+  const double FINE_RADIUS = 2.0; // Radio inicial de la malla fina cuando parte de la gruesa
+  const string TRAIN_IMAGES = "database/train-images.idx3-ubyte";
+  const string TRAIN_LABELS = "database/train-labels.idx1-ubyte";
 
   // --- 1. CARGA DE DATOS ---
+  // Los archivos IDX de MNIST se leen directamente (o se mapean los .kds de
+  // convert.cpp si existen); los píxeles quedan como uint8_t y se escalan a
+  // [0,1] dentro de los kernels
   cout << "Cargando datos de entrenamiento..." << endl;
-  vector<vector<double>> X_full, Y_full_onehot;
-  Reader::load_csv("database/mnist_train_flat_3.csv", X_full, Y_full_onehot, 10);
+  Matrix<uint8_t> X_full;
+  vector<int> Y_full;
+  if (STREAM_CHUNK > 0)
+  {
+    // Solo la validación queda en memoria: el resto se lee en bloques
+    IdxSource source(TRAIN_IMAGES, TRAIN_LABELS);
+    if (!source.ok())
+      return 1;
+    size_t val_size = static_cast<size_t>(source.rows() * VALIDATION_SPLIT);
+    Reader::load_idx(TRAIN_IMAGES, TRAIN_LABELS, X_full, Y_full, val_size);
+  }
+  else
+    Reader::load_mnist("database/mnist_train.kds", TRAIN_IMAGES, TRAIN_LABELS, X_full, Y_full);
 
   if (X_full.empty())
   {
@@ -44,8 +60,10 @@ int main(int argc, char **argv)
   }
 
   cout << "\nCargando datos de prueba..." << endl;
-  vector<vector<double>> X_test, Y_test_onehot;
-  Reader::load_csv("database/mnist_test_flat.csv", X_test, Y_test_onehot, 10);
+  Matrix<uint8_t> X_test;
+  vector<int> Y_test;
+  Reader::load_mnist("database/mnist_test.kds", "database/t10k-images.idx3-ubyte", "database/t10k-labels.idx1-ubyte",
+                     X_test, Y_test);
   if (X_test.empty())
   {
     cerr << "Error: No se pudieron cargar los datos de prueba." << endl;
@@ -53,24 +71,83 @@ int main(int argc, char **argv)
   }
 
   // --- 2. DIVISIÓN DE DATOS (TRAIN/VALIDATION) ---
-  size_t total_samples = X_full.size();
+  // Vistas sobre la misma matriz: no se copia ninguna muestra. En modo flujo
+  // X_full ya es solo la validación y el entrenamiento es el resto del archivo.
+  size_t total_samples = X_full.rows();
   size_t val_size = static_cast<size_t>(total_samples * VALIDATION_SPLIT);
-  vector<vector<double>> X_val(X_full.begin(), X_full.begin() + val_size);
-  vector<vector<double>> Y_val_onehot(Y_full_onehot.begin(), Y_full_onehot.begin() + val_size);
-  vector<vector<double>> X_train(X_full.begin() + val_size, X_full.end());
-  vector<int> Y_val = onehot_to_labels(Y_val_onehot);
-  vector<int> Y_test = onehot_to_labels(Y_test_onehot);
+  if (STREAM_CHUNK > 0)
+    val_size = total_samples;
+  Matrix<uint8_t> X_val = X_full.slice(0, val_size);
+  Matrix<uint8_t> X_train = X_full.slice(val_size, total_samples - val_size);
+  vector<int> Y_val(Y_full.begin(), Y_full.begin() + val_size);
+
+  if (STREAM_CHUNK > 0)
+    cout << "Muestras de entrenamiento: leídas de " << TRAIN_IMAGES << " en bloques de " << STREAM_CHUNK << endl;
+  else
+  {
+    cout << "Total de muestras: " << total_samples << endl;
+    cout << "Muestras de entrenamiento: " << X_train.rows() << endl;
+  }
+  cout << "Muestras de validacion: " << X_val.rows() << endl;
+  cout << "Muestras de prueba: " << X_test.rows() << endl;
+
+  // Entrena y evalúa una red con los datos de la configuración elegida
+  auto train_test = [&](BasicRedKohonen<Real> &net, const string &name)
+  {
+    net.set_bmu_search(BMU_SEARCH);
+    net.set_mini_batch_size(MINI_BATCH_SIZE);
+    net.set_async_evaluation(ASYNC_EVALUATION);
+    if (STREAM_CHUNK > 0)
+    {
+      // Un hilo lee (y baraja) el bloque siguiente mientras se entrena con el actual
+      SampleStream<uint8_t> stream(make_unique<IdxSource>(TRAIN_IMAGES, TRAIN_LABELS, val_size), STREAM_CHUNK, true);
+      net.set_validation_data(X_val, Y_val);
+      net.train_test(stream, X_test, Y_test, name);
+    }
+    else if (SPARSE_INPUT)
+    {
+      net.set_validation_data(SparseMatrix<Real>::from_dense(X_val), Y_val);
+      net.train_test(SparseMatrix<Real>::from_dense(X_train), SparseMatrix<Real>::from_dense(X_test), Y_test, name);
+    }
+    else
+    {
+      net.set_validation_data(X_val, Y_val);
+      net.train_test(X_train, X_test, Y_test, name);
+    }
+  };
 
-  cout << "Total de muestras: " << total_samples << endl;
-  cout << "Muestras de entrenamiento: " << X_train.size() << endl;
-  cout << "Muestras de validacion: " << X_val.size() << endl;
-  cout << "Muestras de prueba: " << X_test.size() << endl;
+  // --resume: continúa desde el último checkpoint de esta configuración
+  const bool resume = argc > 1 && string(argv[1]) == "--resume";
+  size_t coarse_distances = 0;
+  unique_ptr<BasicRedKohonen<Real>> som;
+  if (COARSE_DIM > 0 && !resume)
+  {
+    // De grueso a fino: la malla pequeña fija el orden global y la grande parte de ella
+    BasicRedKohonen<Real> coarse(INPUT_DIM, COARSE_DIM, COARSE_DIM, COARSE_DIM, LEARNING_RATE, COARSE_EPOCHS, MODE,
+                                 ALGORITHM);
+    cout << "\nIniciando entrenamiento de la malla gruesa (" << COARSE_DIM << "x" << COARSE_DIM << "x" << COARSE_DIM
+         << ")..." << endl;
+    train_test(coarse, WEIGHTS_FILENAME + "_coarse");
+    coarse_distances = coarse.get_train_distances();
+    som = make_unique<BasicRedKohonen<Real>>(coarse, DIM_X, DIM_Y, DIM_Z, FINE_LEARNING_RATE, EPOCHS, FINE_RADIUS);
+  }
+  else if (COARSE_DIM > 0)
+    som = make_unique<BasicRedKohonen<Real>>(INPUT_DIM, DIM_X, DIM_Y, DIM_Z, FINE_LEARNING_RATE, EPOCHS, MODE,
+                                             ALGORITHM, FINE_RADIUS);
+  else
+    som = make_unique<BasicRedKohonen<Real>>(INPUT_DIM, DIM_X, DIM_Y, DIM_Z, LEARNING_RATE, EPOCHS, MODE, ALGORITHM);
+
+  if (resume)
+    som->load_weights("output/" + WEIGHTS_FILENAME + "/checkpoint.dat");
 
-  RedKohonen som(INPUT_DIM, DIM_X, DIM_Y, DIM_Z, LEARNING_RATE, EPOCHS,
-                 NeighborhoodMode::GAUSSIAN_RADIUS);
   cout << "\nIniciando entrenamiento de la red de Kohonen..." << endl;
-  som.set_validation_data(X_val, Y_val);
-  som.train_test(X_train, X_test, Y_test, WEIGHTS_FILENAME);
+  train_test(*som, WEIGHTS_FILENAME);
+
+  // Coste del entrenamiento en distancias muestra-neurona calculadas
+  cout << "Distancias de entrenamiento: " << coarse_distances + som->get_train_distances();
+  if (coarse_distances > 0)
+    cout << " (malla gruesa: " << coarse_distances << ", malla fina: " << som->get_train_distances() << ")";
+  cout << endl;
   return 0;
 }
 
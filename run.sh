@@ -4,11 +4,11 @@ set -e # Exit immediately if a command exits with a non-zero status
 case "$1" in
   train)
     echo "Compiling and running 'train' mode..."
-    g++ main.cpp src/*.cpp -Iinclude -O3 -fopenmp -o main && ./main
+    g++ main.cpp src/*.cpp -Iinclude -std=c++20 -O3 -fopenmp -o main && ./main
     ;;
   view)
     echo "Compiling and running 'view' mode (visualizer)..."
-    g++ visualizer.cpp -o visualizer -Iinclude -I. -lglut -lGL -lGLU -lm -fopenmp && ./visualizer
+    g++ visualizer.cpp src/Kernels.cpp -o visualizer -std=c++20 -O3 -Iinclude -I. -lglut -lGL -lGLU -lm -fopenmp && ./visualizer
     ;;
   cmake)
     echo "Starting CMake build process..."
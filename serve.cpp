@@ -0,0 +1,460 @@
+// Servidor de inferencia local: carga un checkpoint una sola vez y responde
+// peticiones binarias (ver include/ServeProtocol.hpp) sobre un socket Unix.
+// Cada conexión tiene un hilo que lee sus peticiones; un único hilo de lotes
+// agrupa las que llegan a la vez desde distintas conexiones en micro-lotes
+// para find_bmu_batch y escribe las respuestas sin bloquearse: un cliente que
+// no lee durante REPLY_TIMEOUT_MS se desconecta.
+//
+// Uso: KohonenServe <checkpoint> [socket] [max_lote] [espera_max_us]
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Checkpoint.hpp"
+#include "RedKohonen.hpp"
+#include "ServeProtocol.hpp"
+#include "Utils.hpp"
+
+using namespace std;
+
+namespace
+{
+    atomic<bool> stop_requested{false};
+
+    void on_signal(int) { stop_requested = true; }
+
+    // Tiempo máximo que el hilo de lotes espera a que un cliente lea una
+    // respuesta; pasado ese tiempo se cierra la conexión
+    constexpr int REPLY_TIMEOUT_MS = 100;
+
+    // Conexión de un cliente. Las respuestas las escribe el hilo de lotes, no
+    // el que lee las peticiones, así que cada escritura toma write_mtx.
+    struct Connection
+    {
+        int fd;
+        mutex write_mtx;
+        atomic<bool> finished{false}; // El hilo de lectura terminó
+        bool dropped = false;         // Cliente lento desconectado (protegido por write_mtx)
+
+        explicit Connection(int fd_) : fd(fd_) {}
+        ~Connection() { ::close(fd); }
+    };
+
+    // Petición completa a la espera de su lote, con las muestras ya en float
+    struct Pending
+    {
+        shared_ptr<Connection> conn;
+        uint32_t id = 0;
+        uint32_t count = 0;
+        vector<float> samples; // count * dims
+        TimePoint arrival;     // Cuando terminó de llegar la petición
+    };
+
+    // Muestras que puede haber en cola antes de que los hilos de lectura se
+    // bloqueen (y dejen de leer de sus sockets) hasta que el hilo de lotes
+    // libere sitio: unos 50 MB con 784 dimensiones
+    constexpr size_t MAX_QUEUED_SAMPLES = 4 * serve::MAX_REQUEST_SAMPLES;
+
+    // Cola compartida por los hilos de lectura y el de lotes
+    class RequestQueue
+    {
+        mutex mtx;
+        condition_variable cv;       // Hay peticiones (para el hilo de lotes)
+        condition_variable space_cv; // Hay sitio (para los hilos de lectura)
+        deque<Pending> pending;
+        size_t queued_samples = 0;
+        bool closed = false;
+
+    public:
+        // Espera a que quepan las muestras de p; con la cola vacía siempre
+        // caben. Devuelve false si la cola se cerró.
+        bool push(Pending p)
+        {
+            {
+                unique_lock<mutex> lock(mtx);
+                space_cv.wait(lock, [&]
+                              { return closed || pending.empty() || queued_samples + p.count <= MAX_QUEUED_SAMPLES; });
+                if (closed)
+                    return false;
+                queued_samples += p.count;
+                pending.push_back(std::move(p));
+            }
+            cv.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            {
+                lock_guard<mutex> lock(mtx);
+                closed = true;
+            }
+            cv.notify_all();
+            space_cv.notify_all();
+        }
+
+        // Espera la primera petición y reúne las que lleguen hasta max_wait
+        // después de ella, o hasta juntar max_samples muestras. Una petición
+        // nunca se parte entre lotes. Devuelve false si la cola se cerró vacía.
+        bool next_batch(vector<Pending> &batch, size_t max_samples, chrono::microseconds max_wait)
+        {
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [&] { return closed || !pending.empty(); });
+            if (pending.empty())
+                return false;
+
+            const TimePoint deadline = pending.front().arrival + max_wait;
+            if (queued_samples < max_samples && Time::now() < deadline)
+                cv.wait_until(lock, deadline, [&] { return closed || queued_samples >= max_samples; });
+
+            size_t total = 0;
+            while (!pending.empty() && (batch.empty() || total + pending.front().count <= max_samples))
+            {
+                total += pending.front().count;
+                queued_samples -= pending.front().count;
+                batch.push_back(std::move(pending.front()));
+                pending.pop_front();
+            }
+            lock.unlock();
+            space_cv.notify_all();
+            return true;
+        }
+    };
+
+    // Latencias de toda la vida del servidor en memoria fija: cubos
+    // logarítmicos (PER_DECADE por década, de 1 us a 100 s) más uno por debajo
+    // y otro por encima. Un percentil se aproxima por el centro geométrico de
+    // su cubo, con un error relativo menor del 3%.
+    class LatencyHistogram
+    {
+        static constexpr double MIN_SECONDS = 1e-6;
+        static constexpr int PER_DECADE = 40;
+        static constexpr int DECADES = 8;
+        array<uint64_t, PER_DECADE * DECADES + 2> counts{};
+        uint64_t total = 0;
+
+    public:
+        void add(double seconds)
+        {
+            int bucket = 0;
+            if (seconds >= MIN_SECONDS)
+                bucket = min(static_cast<int>(counts.size()) - 1,
+                             1 + static_cast<int>(log10(seconds / MIN_SECONDS) * PER_DECADE));
+            counts[bucket]++;
+            total++;
+        }
+
+        double percentile(double p) const
+        {
+            if (total == 0)
+                return 0.0;
+            const uint64_t rank = static_cast<uint64_t>(p * (total - 1) + 0.5);
+            uint64_t seen = 0;
+            size_t bucket = 0;
+            for (; bucket + 1 < counts.size(); ++bucket)
+            {
+                seen += counts[bucket];
+                if (seen > rank)
+                    break;
+            }
+            if (bucket == 0)
+                return MIN_SECONDS;
+            return MIN_SECONDS * pow(10.0, (bucket - 0.5) / PER_DECADE);
+        }
+    };
+
+    // Contadores de una ventana de informe (o del total)
+    struct ServeCounters
+    {
+        size_t requests = 0;
+        size_t samples = 0;
+        size_t batches = 0;
+
+        void add(const ServeCounters &other)
+        {
+            requests += other.requests;
+            samples += other.samples;
+            batches += other.batches;
+        }
+
+        void print(const string &label, double seconds, double p50, double p99) const
+        {
+            // El formato va en un flujo propio para no dejar cambiado el de cout
+            ostringstream line;
+            line << label << fixed << setprecision(2)
+                 << " | Peticiones/s: " << requests / seconds
+                 << " | Muestras/s: " << samples / seconds
+                 << " | Lote medio: " << (batches ? static_cast<double>(samples) / batches : 0.0)
+                 << " | p50: " << p50 * 1e3 << " ms | p99: " << p99 * 1e3 << " ms";
+            cout << line.str() << endl;
+        }
+    };
+
+    void send_reply(Connection &conn, uint32_t id, serve::Status status, const vector<serve::Prediction> &predictions)
+    {
+        serve::ReplyHeader header{};
+        memcpy(header.magic, serve::REPLY_MAGIC, sizeof(serve::REPLY_MAGIC));
+        header.id = id;
+        header.count = status == serve::Status::OK ? static_cast<uint32_t>(predictions.size()) : 0;
+        header.status = static_cast<int32_t>(status);
+
+        // Una sola escritura por respuesta
+        vector<char> frame(sizeof(header) + header.count * sizeof(serve::Prediction));
+        memcpy(frame.data(), &header, sizeof(header));
+        if (header.count > 0)
+            memcpy(frame.data() + sizeof(header), predictions.data(), header.count * sizeof(serve::Prediction));
+
+        // Un cliente que deja de leer llena el buffer de su socket: en lugar de
+        // bloquear el hilo de lotes (y con él a todos los clientes), se le
+        // desconecta. shutdown despierta también a su hilo de lectura.
+        lock_guard<mutex> lock(conn.write_mtx);
+        if (conn.dropped)
+            return;
+        if (!serve::write_full_timeout(conn.fd, frame.data(), frame.size(), REPLY_TIMEOUT_MS))
+        {
+            conn.dropped = true;
+            ::shutdown(conn.fd, SHUT_RDWR);
+            cerr << "Aviso: El cliente no lee sus respuestas, se cierra la conexión." << endl;
+        }
+    }
+
+    // Hilo de lectura de una conexión: valida cada trama, convierte las
+    // muestras a float y las encola
+    void read_requests(shared_ptr<Connection> conn, RequestQueue &queue, uint32_t dims)
+    {
+        using dataset_format::DType;
+        vector<char> payload;
+        serve::RequestHeader header;
+
+        while (serve::read_full(conn->fd, &header, sizeof(header)))
+        {
+            if (memcmp(header.magic, serve::REQUEST_MAGIC, sizeof(serve::REQUEST_MAGIC)) != 0)
+            {
+                cerr << "Error: Trama inválida, se cierra la conexión." << endl;
+                send_reply(*conn, header.id, serve::Status::BAD_FRAME, {});
+                return;
+            }
+
+            DType dtype = static_cast<DType>(header.dtype);
+            serve::Status status = serve::Status::OK;
+            if (dtype != DType::UINT8 && dtype != DType::FLOAT32)
+                status = serve::Status::BAD_DTYPE;
+            else if (header.dims != dims)
+                status = serve::Status::BAD_DIMS;
+            else if (header.count > serve::MAX_REQUEST_SAMPLES)
+                status = serve::Status::TOO_MANY;
+            if (status != serve::Status::OK)
+            {
+                send_reply(*conn, header.id, status, {});
+                return;
+            }
+
+            const size_t n = static_cast<size_t>(header.count) * dims;
+            payload.resize(n * dataset_format::dtype_size(dtype));
+            if (!serve::read_full(conn->fd, payload.data(), payload.size()))
+                return;
+
+            Pending p;
+            p.conn = conn;
+            p.id = header.id;
+            p.count = header.count;
+            p.samples.resize(n);
+            if (dtype == DType::UINT8)
+                kernels::widen_u8(reinterpret_cast<const uint8_t *>(payload.data()), n, PIXEL_SCALE, p.samples.data());
+            else
+                memcpy(p.samples.data(), payload.data(), payload.size());
+            p.arrival = start_timer();
+            if (!queue.push(std::move(p)))
+                return;
+        }
+    }
+
+    // Hilo de lotes: busca las BMUs de cada micro-lote y responde
+    void serve_batches(const BasicRedKohonen<float> &som, RequestQueue &queue, size_t max_batch,
+                       chrono::microseconds max_wait, double report_seconds)
+    {
+        const Matrix<float> &codebook = som.get_codebook();
+        const vector<int> &labels = som.get_labels();
+        const size_t dims = codebook.cols();
+        const int dim_x = som.get_dim_x(), dim_y = som.get_dim_y();
+
+        // Una petición sola puede superar max_batch (hasta MAX_REQUEST_SAMPLES)
+        Matrix<float> samples(max(max_batch, static_cast<size_t>(serve::MAX_REQUEST_SAMPLES)), dims);
+        vector<Pending> batch;
+        vector<int> bmus;
+        vector<double> dist_sq;
+        vector<serve::Prediction> predictions;
+        // La ventana guarda sus latencias exactas; el total, solo el histograma
+        ServeCounters window, total;
+        vector<double> window_latencies; // Segundos desde `arrival` hasta enviar la respuesta
+        LatencyHistogram total_latencies;
+        TimePoint started = start_timer(), window_start = started;
+
+        while (queue.next_batch(batch, max_batch, max_wait))
+        {
+            size_t rows = 0;
+            for (const Pending &p : batch)
+            {
+                for (uint32_t i = 0; i < p.count; ++i)
+                    copy_n(p.samples.data() + i * dims, dims, samples.row(rows + i));
+                rows += p.count;
+            }
+
+            bmus.resize(rows);
+            dist_sq.resize(rows);
+            som.find_bmu_batch(samples.slice(0, rows), bmus, dist_sq);
+
+            size_t offset = 0;
+            for (const Pending &p : batch)
+            {
+                predictions.resize(p.count);
+                for (uint32_t i = 0; i < p.count; ++i)
+                {
+                    int bmu = bmus[offset + i];
+                    predictions[i] = {labels[bmu], bmu % dim_x, (bmu % (dim_x * dim_y)) / dim_x, bmu / (dim_x * dim_y),
+                                      static_cast<float>(sqrt(dist_sq[offset + i]))};
+                }
+                offset += p.count;
+                send_reply(*p.conn, p.id, serve::Status::OK, predictions);
+                const double latency = stop_timer(p.arrival);
+                window_latencies.push_back(latency);
+                total_latencies.add(latency);
+            }
+
+            window.requests += batch.size();
+            window.samples += rows;
+            window.batches++;
+            batch.clear();
+
+            double elapsed = stop_timer(window_start);
+            if (elapsed >= report_seconds)
+            {
+                window.print("[serve]", elapsed, percentile(window_latencies, 0.50), percentile(window_latencies, 0.99));
+                total.add(window);
+                window = ServeCounters();
+                window_latencies.clear();
+                window_start = start_timer();
+            }
+        }
+
+        total.add(window);
+        if (total.requests > 0)
+            total.print("[serve] Total", stop_timer(started), total_latencies.percentile(0.50),
+                        total_latencies.percentile(0.99));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_batch = 256;
+    long long max_wait_us = 0;
+    if (argc < 2 || (argc > 3 && (!parse_number(argv[3], max_batch) || max_batch < 1)) ||
+        (argc > 4 && (!parse_number(argv[4], max_wait_us) || max_wait_us < 0)))
+    {
+        cerr << "Uso: " << argv[0] << " <checkpoint> [socket] [max_lote] [espera_max_us]" << endl;
+        cerr << "  max_lote >= 1 (256 por defecto), espera_max_us >= 0 (0 por defecto)" << endl;
+        return 1;
+    }
+    const string checkpoint_file = argv[1];
+    const string socket_path = argc > 2 ? argv[2] : serve::DEFAULT_SOCKET;
+    const chrono::microseconds max_wait(max_wait_us);
+    const double REPORT_SECONDS = 5.0;
+
+    // Las dimensiones de la red salen de la cabecera del checkpoint
+    checkpoint::Data<float> data;
+    if (!checkpoint::load(checkpoint_file, data))
+        return 1;
+    const uint32_t dims = static_cast<uint32_t>(data.weights.cols());
+    BasicRedKohonen<float> som(static_cast<int>(dims), data.dim_x, data.dim_y, data.dim_z);
+    som.load_weights(std::move(data));
+
+    sockaddr_un addr;
+    if (!serve::make_address(socket_path, addr))
+    {
+        cerr << "Error: Ruta de socket demasiado larga: " << socket_path << endl;
+        return 1;
+    }
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(socket_path.c_str());
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listener, SOMAXCONN) != 0)
+    {
+        cerr << "Error: No se pudo escuchar en " << socket_path << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    struct sigaction action{};
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    // Hilo de lectura de cada conexión abierta
+    struct Reader
+    {
+        thread worker;
+        shared_ptr<Connection> conn;
+    };
+
+    RequestQueue queue;
+    thread batcher(serve_batches, cref(som), ref(queue), max_batch, max_wait, REPORT_SECONDS);
+    vector<Reader> readers;
+
+    cout << "Sirviendo " << checkpoint_file << " en " << socket_path << " (" << dims << " dimensiones, lote máximo "
+         << max_batch << ", espera máxima " << max_wait.count() << " us, kernels " << kernels::isa_name() << ")"
+         << endl;
+
+    // poll con timeout para comprobar periódicamente si llegó una señal
+    pollfd listen_poll{listener, POLLIN, 0};
+    while (!stop_requested)
+    {
+        // Libera los hilos de las conexiones que el cliente ya cerró
+        erase_if(readers, [](Reader &r)
+                 {
+                     if (!r.conn->finished)
+                         return false;
+                     r.worker.join();
+                     return true; });
+
+        if (::poll(&listen_poll, 1, 200) <= 0)
+            continue;
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        auto conn = make_shared<Connection>(fd);
+        thread worker([conn, &queue, dims]
+                      {
+                          read_requests(conn, queue, dims);
+                          conn->finished = true; });
+        readers.push_back({std::move(worker), conn});
+    }
+
+    // Desbloquea las lecturas pendientes; las respuestas en curso se completan
+    cout << "\nDeteniendo el servidor..." << endl;
+    for (Reader &r : readers)
+        ::shutdown(r.conn->fd, SHUT_RD);
+    for (Reader &r : readers)
+        r.worker.join();
+    readers.clear();
+    queue.close();
+    batcher.join();
+
+    ::close(listener);
+    ::unlink(socket_path.c_str());
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Generador de carga para KohonenServe. Abre varias conexiones que envían
+// peticiones en bucle cerrado (cada una espera su respuesta antes de enviar
+// la siguiente) con imágenes del conjunto de test de MNIST, y al final
+// informa el rendimiento, las latencias vistas por el cliente y la precisión
+// de las etiquetas devueltas.
+//
+// Uso: KohonenServeClient [socket] [conexiones] [muestras_por_peticion] [segundos]
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Reader.hpp"
+#include "ServeProtocol.hpp"
+#include "Utils.hpp"
+
+using namespace std;
+
+namespace
+{
+    // Resultado de una conexión
+    struct ClientStats
+    {
+        vector<double> latencies; // Segundos por petición, vistos por el cliente
+        size_t requests = 0;
+        size_t samples = 0;
+        size_t correct = 0;
+        bool failed = false;
+    };
+
+    int connect_to(const string &socket_path)
+    {
+        sockaddr_un addr;
+        if (!serve::make_address(socket_path, addr))
+            return -1;
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Envía peticiones de `batch` imágenes consecutivas (empezando en `first`)
+    // hasta `deadline`
+    ClientStats run_connection(const string &socket_path, const Matrix<uint8_t> &X, const vector<int> &Y,
+                               size_t first, uint32_t batch, TimePoint deadline)
+    {
+        ClientStats stats;
+        int fd = connect_to(socket_path);
+        if (fd < 0)
+        {
+            cerr << "Error: No se pudo conectar a " << socket_path << ": " << strerror(errno) << endl;
+            stats.failed = true;
+            return stats;
+        }
+
+        const size_t dims = X.cols();
+        vector<char> frame(sizeof(serve::RequestHeader) + batch * dims);
+        vector<serve::Prediction> predictions(batch);
+        size_t next = first % X.rows();
+        uint32_t id = 0;
+
+        while (Time::now() < deadline)
+        {
+            serve::RequestHeader header{};
+            memcpy(header.magic, serve::REQUEST_MAGIC, sizeof(serve::REQUEST_MAGIC));
+            header.id = id++;
+            header.count = batch;
+            header.dims = static_cast<uint32_t>(dims);
+            header.dtype = static_cast<uint32_t>(dataset_format::DType::UINT8);
+            memcpy(frame.data(), &header, sizeof(header));
+
+            vector<int> expected(batch);
+            for (uint32_t i = 0; i < batch; ++i)
+            {
+                size_t row = (next + i) % X.rows();
+                memcpy(frame.data() + sizeof(header) + i * dims, X.row(row), dims);
+                expected[i] = Y[row];
+            }
+            next = (next + batch) % X.rows();
+
+            auto start = start_timer();
+            serve::ReplyHeader reply;
+            if (!serve::write_full(fd, frame.data(), frame.size()) || !serve::read_full(fd, &reply, sizeof(reply)))
+            {
+                cerr << "Error: El servidor cerró la conexión." << endl;
+                stats.failed = true;
+                break;
+            }
+            if (memcmp(reply.magic, serve::REPLY_MAGIC, sizeof(serve::REPLY_MAGIC)) != 0 || reply.id != header.id ||
+                reply.status != static_cast<int32_t>(serve::Status::OK) || reply.count != batch)
+            {
+                cerr << "Error: Respuesta inválida (status " << reply.status << ")." << endl;
+                stats.failed = true;
+                break;
+            }
+            if (!serve::read_full(fd, predictions.data(), batch * sizeof(serve::Prediction)))
+            {
+                stats.failed = true;
+                break;
+            }
+            stats.latencies.push_back(stop_timer(start));
+
+            stats.requests++;
+            stats.samples += batch;
+            for (uint32_t i = 0; i < batch; ++i)
+                stats.correct += predictions[i].label == expected[i];
+        }
+        ::close(fd);
+        return stats;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const string socket_path = argc > 1 ? argv[1] : serve::DEFAULT_SOCKET;
+    int connections = 4;
+    uint32_t batch = 1;
+    double seconds = 10.0;
+    if ((argc > 2 && !parse_number(argv[2], connections)) || (argc > 3 && !parse_number(argv[3], batch)) ||
+        (argc > 4 && (!parse_number(argv[4], seconds) || !(seconds > 0.0))))
+    {
+        cerr << "Uso: " << argv[0] << " [socket] [conexiones] [muestras_por_peticion] [segundos]" << endl;
+        return 1;
+    }
+
+    Matrix<uint8_t> X_test;
+    vector<int> Y_test;
+    Reader::load_idx("database/t10k-images.idx3-ubyte", "database/t10k-labels.idx1-ubyte", X_test, Y_test);
+    if (X_test.empty())
+    {
+        cerr << "Error: No se pudieron cargar los datos de prueba." << endl;
+        return 1;
+    }
+    if (connections < 1 || batch < 1 || batch > serve::MAX_REQUEST_SAMPLES)
+    {
+        cerr << "Error: Se necesita al menos una conexión y entre 1 y " << serve::MAX_REQUEST_SAMPLES
+             << " muestras por petición." << endl;
+        return 1;
+    }
+
+    cout << "Enviando peticiones de " << batch << " muestras por " << connections << " conexiones durante "
+         << seconds << " s..." << endl;
+
+    // Cada conexión empieza en una zona distinta del conjunto de test
+    vector<ClientStats> results(connections);
+    vector<thread> workers;
+    const TimePoint started = start_timer();
+    const TimePoint deadline = started + chrono::duration_cast<Time::duration>(chrono::duration<double>(seconds));
+    for (int c = 0; c < connections; ++c)
+        workers.emplace_back([&, c]
+                             { results[c] = run_connection(socket_path, X_test, Y_test, c * X_test.rows() / connections,
+                                                           batch, deadline); });
+    for (thread &t : workers)
+        t.join();
+    const double elapsed = stop_timer(started);
+
+    ClientStats total;
+    for (ClientStats &r : results)
+    {
+        total.latencies.insert(total.latencies.end(), r.latencies.begin(), r.latencies.end());
+        total.requests += r.requests;
+        total.samples += r.samples;
+        total.correct += r.correct;
+        total.failed = total.failed || r.failed;
+    }
+    if (total.requests == 0)
+    {
+        cerr << "Error: No se completó ninguna petición." << endl;
+        return 1;
+    }
+
+    double p50 = percentile(total.latencies, 0.50) * 1e3;
+    double p99 = percentile(total.latencies, 0.99) * 1e3;
+    cout << fixed << setprecision(2)
+         << "Peticiones: " << total.requests << " | Peticiones/s: " << total.requests / elapsed
+         << " | Muestras/s: " << total.samples / elapsed
+         << " | p50: " << p50 << " ms | p99: " << p99 << " ms"
+         << " | Precisión: " << 100.0 * total.correct / total.samples << "%" << endl;
+    return total.failed ? 1 : 0;
+}
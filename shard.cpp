@@ -0,0 +1,351 @@
+// Entrenamiento SOM por lotes repartido entre varios procesos de la misma
+// máquina. El conjunto de entrenamiento se divide en fragmentos, uno por
+// proceso, y todos comparten por memoria POSIX (shm_open) el codebook y sus
+// sumas parciales. En cada época:
+//
+//   1. Cada proceso busca las BMUs de su fragmento con su propio equipo de
+//      OpenMP y acumula las sumas S_j y conteos n_j en su zona de parciales.
+//   2. Barrera. Cada proceso reduce los parciales de todos para su rango de
+//      neuronas.
+//   3. Barrera. Cada proceso recalcula los prototipos de su rango, que
+//      escribe directamente en el codebook compartido.
+//   4. Barrera. El proceso 0 (coordinador) etiqueta con la validación, mide
+//      la precisión y guarda los checkpoints, mientras el resto empieza la
+//      época siguiente (solo lee el codebook).
+//
+// Las barreras son un pthread_barrier_t compartido entre procesos dentro del
+// mismo segmento. Los procesos se crean con fork antes de que el padre use
+// OpenMP, y heredan las muestras ya cargadas sin copiarlas.
+//
+// Uso: KohonenShardTrainer [procesos] [hilos_por_proceso] [--resume]
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <omp.h>
+#include <pthread.h>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Reader.hpp"
+#include "RedKohonen.hpp"
+#include "Utils.hpp"
+
+using namespace std;
+
+namespace
+{
+  // --- PARÁMETROS CONFIGURABLES (como en main.cpp) ---
+  const int DIM_X = 10;
+  const int DIM_Y = 10;
+  const int DIM_Z = 10;
+  const int EPOCHS = 5;
+  const double LEARNING_RATE = 0.5;
+  const int INPUT_DIM = 784;
+  const double VALIDATION_SPLIT = 0.20;
+  const string WEIGHTS_FILENAME = "mnist_batch_shards";
+  const NeighborhoodMode MODE = NeighborhoodMode::GAUSSIAN_RADIUS;
+  using Real = float;
+
+  // Cabecera del segmento compartido
+  struct alignas(64) Control
+  {
+    pthread_barrier_t barrier;
+    int first_epoch; // Lo fija el proceso 0 (tras --resume puede no ser 0)
+  };
+
+  // Elementos por fila con el mismo relleno que Matrix
+  template <typename T>
+  size_t padded(size_t cols)
+  {
+    constexpr size_t per_line = Matrix<T>::ALIGNMENT / sizeof(T);
+    return (cols + per_line - 1) / per_line * per_line;
+  }
+
+  // Reparto del segmento: cada zona empieza alineada a 64 bytes
+  struct Layout
+  {
+    size_t neurons, workers;
+    size_t codebook_stride, sums_stride;
+    size_t codebook, partial_sums, partial_counts, sums, counts, bytes;
+
+    Layout(size_t neurons_, size_t dims, size_t workers_)
+        : neurons(neurons_), workers(workers_), codebook_stride(padded<Real>(dims)), sums_stride(padded<double>(dims))
+    {
+      auto line = [](size_t b) { return (b + 63) / 64 * 64; };
+      codebook = sizeof(Control);
+      partial_sums = codebook + line(neurons * codebook_stride * sizeof(Real));
+      partial_counts = partial_sums + workers * neurons * sums_stride * sizeof(double);
+      sums = partial_counts + line(workers * neurons * sizeof(double));
+      counts = sums + neurons * sums_stride * sizeof(double);
+      bytes = counts + line(neurons * sizeof(double));
+    }
+  };
+
+  // Vistas de un proceso sobre el segmento
+  struct Shared
+  {
+    Control *control;
+    Matrix<Real> codebook;
+    vector<Matrix<double>> partial_sums;
+    vector<span<double>> partial_counts;
+    Matrix<double> sums;
+    span<double> counts;
+
+    Shared(char *base, const Layout &l, size_t dims) : control(reinterpret_cast<Control *>(base))
+    {
+      codebook = Matrix<Real>::wrap(reinterpret_cast<Real *>(base + l.codebook), l.neurons, dims, l.codebook_stride, nullptr);
+      for (size_t w = 0; w < l.workers; ++w)
+      {
+        double *s = reinterpret_cast<double *>(base + l.partial_sums) + w * l.neurons * l.sums_stride;
+        partial_sums.push_back(Matrix<double>::wrap(s, l.neurons, dims, l.sums_stride, nullptr));
+        partial_counts.emplace_back(reinterpret_cast<double *>(base + l.partial_counts) + w * l.neurons, l.neurons);
+      }
+      sums = Matrix<double>::wrap(reinterpret_cast<double *>(base + l.sums), l.neurons, dims, l.sums_stride, nullptr);
+      counts = span<double>(reinterpret_cast<double *>(base + l.counts), l.neurons);
+    }
+
+    void wait() { pthread_barrier_wait(&control->barrier); }
+  };
+
+  struct Dataset
+  {
+    Matrix<uint8_t> X_train, X_val, X_test;
+    vector<int> Y_val, Y_test;
+  };
+
+  int run_worker(int rank, int workers, int threads, bool resume, const Dataset &data, Shared &shared)
+  {
+    omp_set_num_threads(threads);
+    const int neurons = DIM_X * DIM_Y * DIM_Z;
+    const int begin = neurons * rank / workers, end = neurons * (rank + 1) / workers;
+    const size_t n = data.X_train.rows();
+    const size_t shard_begin = n * rank / workers, shard_end = n * (rank + 1) / workers;
+    const Matrix<uint8_t> shard = data.X_train.slice(shard_begin, shard_end - shard_begin);
+
+    BasicRedKohonen<Real> som(INPUT_DIM, DIM_X, DIM_Y, DIM_Z, LEARNING_RATE, EPOCHS, MODE, TrainingAlgorithm::BATCH);
+    const string output_dir = "output/" + WEIGHTS_FILENAME;
+
+    // El proceso 0 publica los pesos iniciales (aleatorios o del checkpoint)
+    if (rank == 0)
+    {
+      if (resume)
+        som.load_weights(output_dir + "/checkpoint.dat");
+      shared.control->first_epoch = som.get_train_state().epoch + 1;
+      som.attach_codebook(shared.codebook, true);
+    }
+    shared.wait();
+    if (rank != 0)
+      som.attach_codebook(shared.codebook, false);
+    const int first_epoch = shared.control->first_epoch;
+
+    ofstream log_file;
+    if (rank == 0)
+    {
+      filesystem::create_directories(output_dir);
+      log_file.open(output_dir + "/log.txt", first_epoch > 0 ? ios::app : ios::trunc);
+    }
+
+    float best_test_acc = 0.0f;
+    int best_epoch = -1;
+    for (int epoch = first_epoch; epoch < EPOCHS; ++epoch)
+    {
+      auto start = start_timer();
+
+      // 1. Parciales del fragmento propio
+      Matrix<double> &own_sums = shared.partial_sums[rank];
+      for (int i = 0; i < neurons; ++i)
+        fill_n(own_sums.row(i), INPUT_DIM, 0.0);
+      fill(shared.partial_counts[rank].begin(), shared.partial_counts[rank].end(), 0.0);
+      som.batch_partials(epoch, shard, own_sums, shared.partial_counts[rank]);
+      shared.wait();
+
+      // 2. Reducción del rango de neuronas propio
+#pragma omp parallel for schedule(static)
+      for (int i = begin; i < end; ++i)
+      {
+        double *acc = shared.sums.row(i);
+        fill_n(acc, INPUT_DIM, 0.0);
+        double count = 0.0;
+        for (int w = 0; w < workers; ++w)
+        {
+          count += shared.partial_counts[w][i];
+          if (shared.partial_counts[w][i] == 0.0)
+            continue;
+          const double *src = shared.partial_sums[w].row(i);
+          for (int k = 0; k < INPUT_DIM; ++k)
+            acc[k] += src[k];
+        }
+        shared.counts[i] = count;
+      }
+      shared.wait();
+
+      // 3. Nuevos prototipos del rango propio
+      som.batch_update(shared.sums, shared.counts, begin, end);
+      shared.wait();
+
+      if (rank != 0)
+        continue;
+
+      // 4. Coordinador: evaluación y checkpoints
+      double train_time = stop_timer(start);
+      som.refresh_codebook();
+      Evaluation val = som.evaluate(data.X_val, data.Y_val);
+      float test_acc = som.test_accuracy(data.X_test, data.Y_test);
+      double total_time = stop_timer(start);
+
+      ostringstream line;
+      line << "Epoch " << epoch + 1 << "/" << EPOCHS << " | Batch x" << workers << " procesos";
+      if (MODE != NeighborhoodMode::BMU_ONLY)
+        line << " | Radius: " << som.get_train_state().radius;
+      line << " | Train Time: " << train_time << "s | Val Acc: " << val.accuracy * 100.0f
+           << "% | Val QE: " << val.quantization_error << " | Test Acc: " << test_acc * 100.0f << "% | Total Time: " << total_time << "s";
+      cout << line.str() << endl;
+      log_file << line.str() << endl;
+
+      if ((epoch + 1) % som.get_checkpoint_interval() == 0)
+        som.save_weights(output_dir + "/checkpoint.dat");
+      if (test_acc > best_test_acc)
+      {
+        best_test_acc = test_acc;
+        best_epoch = epoch;
+        som.save_weights(output_dir + "/best_model.dat");
+      }
+    }
+
+    if (rank == 0)
+    {
+      som.save_weights(output_dir + "/final.dat");
+      cout << "Best Test Accuracy: " << best_test_acc * 100.0f << "% at epoch " << (best_epoch + 1) << endl;
+      log_file << "Best Test Accuracy: " << best_test_acc * 100.0f << "% at epoch " << (best_epoch + 1) << endl;
+    }
+    return 0;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  vector<string> args(argv + 1, argv + argc);
+  const bool resume = find(args.begin(), args.end(), "--resume") != args.end();
+  args.erase(remove(args.begin(), args.end(), "--resume"), args.end());
+  int workers = 2, threads = 0;
+  if (args.size() > 2 || (args.size() > 0 && (!parse_number(args[0].c_str(), workers) || workers < 1)) ||
+      (args.size() > 1 && (!parse_number(args[1].c_str(), threads) || threads < 1)))
+  {
+    cerr << "Uso: " << argv[0] << " [procesos] [hilos_por_proceso] [--resume]" << endl;
+    cerr << "  procesos >= 1 (2 por defecto), hilos_por_proceso >= 1 (núcleos / procesos por defecto)" << endl;
+    return 1;
+  }
+  // omp_get_num_procs no crea hilos: el runtime sigue sin arrancar antes del fork
+  if (args.size() < 2)
+    threads = max(1, omp_get_num_procs() / workers);
+
+  // --- 1. CARGA DE DATOS (antes del fork: los procesos la heredan) ---
+  Dataset data;
+  Matrix<uint8_t> X_full;
+  vector<int> Y_full;
+  Reader::load_mnist("database/mnist_train.kds", "database/train-images.idx3-ubyte", "database/train-labels.idx1-ubyte",
+                     X_full, Y_full);
+  Reader::load_mnist("database/mnist_test.kds", "database/t10k-images.idx3-ubyte", "database/t10k-labels.idx1-ubyte",
+                     data.X_test, data.Y_test);
+  if (X_full.empty() || data.X_test.empty())
+  {
+    cerr << "Error: No se pudieron cargar los datos de MNIST." << endl;
+    return 1;
+  }
+  const size_t val_size = static_cast<size_t>(X_full.rows() * VALIDATION_SPLIT);
+  data.X_val = X_full.slice(0, val_size);
+  data.X_train = X_full.slice(val_size, X_full.rows() - val_size);
+  data.Y_val.assign(Y_full.begin(), Y_full.begin() + val_size);
+
+  // --- 2. SEGMENTO COMPARTIDO ---
+  // Se borra el nombre en cuanto está mapeado: los hijos heredan el mapeo y
+  // no queda nada en /dev/shm aunque algún proceso muera
+  const Layout layout(DIM_X * DIM_Y * DIM_Z, INPUT_DIM, workers);
+  const string shm_name = "/kohonen_shard_" + to_string(getpid());
+  int fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+  {
+    cerr << "Error: shm_open(" << shm_name << "): " << strerror(errno) << endl;
+    return 1;
+  }
+  shm_unlink(shm_name.c_str());
+  if (ftruncate(fd, layout.bytes) != 0)
+  {
+    cerr << "Error: No se pudieron reservar " << layout.bytes << " bytes de memoria compartida: " << strerror(errno)
+         << endl;
+    close(fd);
+    return 1;
+  }
+  void *mem = mmap(nullptr, layout.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED)
+  {
+    cerr << "Error: mmap: " << strerror(errno) << endl;
+    return 1;
+  }
+  Shared shared(static_cast<char *>(mem), layout, INPUT_DIM);
+
+  pthread_barrierattr_t attr;
+  pthread_barrierattr_init(&attr);
+  pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_barrier_init(&shared.control->barrier, &attr, workers);
+  pthread_barrierattr_destroy(&attr);
+
+  cout << "Entrenando con " << workers << " procesos x " << threads << " hilos, " << data.X_train.rows()
+       << " muestras (" << layout.bytes / (1024 * 1024) << " MB compartidos)" << endl;
+
+  // --- 3. PROCESOS ---
+  vector<pid_t> children;
+  for (int rank = 0; rank < workers; ++rank)
+  {
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      cerr << "Error: fork: " << strerror(errno) << endl;
+      for (pid_t child : children)
+        kill(child, SIGKILL);
+      break;
+    }
+    if (pid == 0)
+    {
+      int status = run_worker(rank, workers, threads, resume, data, shared);
+      cout.flush();
+      _exit(status);
+    }
+    children.push_back(pid);
+  }
+
+  // Si un proceso falla, el resto quedaría esperando en la barrera
+  bool failed = static_cast<int>(children.size()) != workers;
+  for (size_t remaining = children.size(); remaining > 0; --remaining)
+  {
+    int status = 0;
+    pid_t pid = wait(&status);
+    if (pid < 0)
+      break;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      if (!failed)
+        cerr << "Error: El proceso " << pid << " terminó de forma anormal; se detienen los demás." << endl;
+      failed = true;
+      for (pid_t child : children)
+        if (child != pid)
+          kill(child, SIGKILL);
+    }
+  }
+
+  // Si algún proceso murió dentro de la barrera, destruirla esperaría para siempre
+  if (!failed)
+    pthread_barrier_destroy(&shared.control->barrier);
+  munmap(mem, layout.bytes);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,916 @@
+#include "Kernels.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KOHONEN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Todas las variantes calculan K distancias a la vez. Con K = 1 se
+    // obtiene l2sq y con K = 4 l2sq_x4; como comparten el mismo código, el
+    // orden de suma (y por tanto el resultado) es idéntico en ambos casos.
+    // Cada kernel se escribe una vez para el tipo de elemento E (double o
+    // float): las sumas parciales van en E y el resultado se entrega en double.
+    // Con N > 0 la longitud es la constante N en lugar de `len` (ver
+    // kernels::for_dim): mismo código y mismo orden de suma, pero el
+    // compilador desenrolla los bucles y resuelve el resto al compilar.
+
+    // --- Escalar: mismo orden de suma que el bucle original de Neuron ---
+    template <typename E, int K, size_t N = 0>
+    void l2sq_scalar(const E *x, const E *w, size_t stride, size_t len, double *out)
+    {
+        const size_t n = N ? N : len;
+        E acc[K] = {};
+        for (size_t i = 0; i < n; ++i)
+        {
+            E xi = x[i];
+            for (int k = 0; k < K; ++k)
+            {
+                E diff = xi - w[k * stride + i];
+                acc[k] += diff * diff;
+            }
+        }
+        for (int k = 0; k < K; ++k)
+            out[k] = acc[k];
+    }
+
+    // Distancia por bloques con abandono temprano
+    template <typename E>
+    double l2sq_bounded_scalar(const E *x, const E *w, const uint32_t *blocks, size_t n_blocks, size_t n,
+                               double bound, size_t &evaluated)
+    {
+        double d = 0.0;
+        size_t done = 0;
+        for (size_t b = 0; b < n_blocks; ++b)
+        {
+            const size_t from = blocks[b], to = std::min(from + kernels::BOUNDED_BLOCK, n);
+            E acc = 0;
+            for (size_t i = from; i < to; ++i)
+            {
+                E diff = x[i] - w[i];
+                acc += diff * diff;
+            }
+            d += acc;
+            done += to - from;
+            if (d > bound)
+                break;
+        }
+        evaluated = done;
+        return d;
+    }
+
+    // Producto punto disperso-denso, con 4 acumuladores independientes para
+    // no quedar limitado por la latencia de la suma
+    template <typename E>
+    double sparse_dot_scalar(const uint32_t *idx, const E *val, size_t nnz, const E *w)
+    {
+        E acc[4] = {};
+        size_t k = 0;
+        for (; k + 4 <= nnz; k += 4)
+            for (int j = 0; j < 4; ++j)
+                acc[j] += val[k + j] * w[idx[k + j]];
+        for (; k < nnz; ++k)
+            acc[0] += val[k] * w[idx[k]];
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+
+    // y += a * x
+    template <typename E>
+    void axpy_scalar(double a, const E *x, size_t n, E *y)
+    {
+        const E s = static_cast<E>(a);
+        for (size_t i = 0; i < n; ++i)
+            y[i] += s * x[i];
+    }
+
+    // Copia n elementos de w, compartido entre hilos, con lecturas relajadas
+    template <typename E>
+    void load_relaxed(const E *w, size_t n, E *out)
+    {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = std::atomic_ref<E>(const_cast<E &>(w[i])).load(std::memory_order_relaxed);
+    }
+
+    // w += a * (x - w) con w compartido entre hilos: cada elemento se lee y
+    // escribe con un atomic_ref relajado, y el valor escrito queda en local
+    template <typename E>
+    void lerp_shared_scalar(double a, const E *x, size_t n, E *w, E *local)
+    {
+        const E s = static_cast<E>(a);
+        for (size_t i = 0; i < n; ++i)
+        {
+            std::atomic_ref<E> wi(w[i]);
+            const E current = wi.load(std::memory_order_relaxed);
+            local[i] = current + s * (x[i] - current);
+            wi.store(local[i], std::memory_order_relaxed);
+        }
+    }
+
+    // Productos punto de un bloque MR x NR: C[a][b] = <X_a, W_b>
+    template <typename E, int MR, int NR>
+    void dot_scalar(const E *X, size_t ldx, const E *W, size_t ldw, size_t n, double *C, size_t ldc, bool accumulate)
+    {
+        for (int a = 0; a < MR; ++a)
+            for (int b = 0; b < NR; ++b)
+            {
+                E acc = 0;
+                for (size_t i = 0; i < n; ++i)
+                    acc += X[a * ldx + i] * W[b * ldw + i];
+                C[a * ldc + b] = accumulate ? C[a * ldc + b] + acc : acc;
+            }
+    }
+
+    // Conversión de muestras de 8 bits al tipo de elemento, escaladas
+    template <typename E>
+    void widen_u8_scalar(const uint8_t *src, size_t n, double scale, E *dst)
+    {
+        for (size_t i = 0; i < n; ++i)
+            dst[i] = static_cast<E>(src[i] * scale);
+    }
+
+#ifdef KOHONEN_X86
+#define KOHONEN_SSE2 __attribute__((target("sse2"))) static inline
+#define KOHONEN_AVX2 __attribute__((target("avx2,fma"))) static inline
+#define KOHONEN_AVX512 __attribute__((target("avx512f"))) static inline
+
+    // Operaciones vectoriales de cada ISA para cada tipo de elemento; W es el
+    // número de lanes y hsum reduce un registro a double
+    template <typename E>
+    struct Sse2;
+
+    template <>
+    struct Sse2<double>
+    {
+        using V = __m128d;
+        static constexpr int W = 2;
+        KOHONEN_SSE2 V zero() { return _mm_setzero_pd(); }
+        KOHONEN_SSE2 V load(const double *p) { return _mm_loadu_pd(p); }
+        KOHONEN_SSE2 V sub(V a, V b) { return _mm_sub_pd(a, b); }
+        KOHONEN_SSE2 V add(V a, V b) { return _mm_add_pd(a, b); }
+        KOHONEN_SSE2 V sq_acc(V d, V acc) { return _mm_add_pd(acc, _mm_mul_pd(d, d)); }
+        KOHONEN_SSE2 double hsum(V v) { return _mm_cvtsd_f64(v) + _mm_cvtsd_f64(_mm_unpackhi_pd(v, v)); }
+    };
+
+    template <>
+    struct Sse2<float>
+    {
+        using V = __m128;
+        static constexpr int W = 4;
+        KOHONEN_SSE2 V zero() { return _mm_setzero_ps(); }
+        KOHONEN_SSE2 V load(const float *p) { return _mm_loadu_ps(p); }
+        KOHONEN_SSE2 V sub(V a, V b) { return _mm_sub_ps(a, b); }
+        KOHONEN_SSE2 V add(V a, V b) { return _mm_add_ps(a, b); }
+        KOHONEN_SSE2 V sq_acc(V d, V acc) { return _mm_add_ps(acc, _mm_mul_ps(d, d)); }
+        KOHONEN_SSE2 double hsum(V v)
+        {
+            __m128 pair = _mm_add_ps(v, _mm_movehl_ps(v, v));
+            return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+        }
+    };
+
+    template <typename E>
+    struct Avx2;
+
+    template <>
+    struct Avx2<double>
+    {
+        using V = __m256d;
+        static constexpr int W = 4;
+        KOHONEN_AVX2 V zero() { return _mm256_setzero_pd(); }
+        KOHONEN_AVX2 V set1(double v) { return _mm256_set1_pd(v); }
+        KOHONEN_AVX2 V load(const double *p) { return _mm256_loadu_pd(p); }
+        KOHONEN_AVX2 void store(double *p, V v) { _mm256_storeu_pd(p, v); }
+        KOHONEN_AVX2 V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+        KOHONEN_AVX2 V add(V a, V b) { return _mm256_add_pd(a, b); }
+        KOHONEN_AVX2 V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+        KOHONEN_AVX2 V fmadd(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); }
+        KOHONEN_AVX2 double hsum(V v)
+        {
+            __m128d half = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+            return _mm_cvtsd_f64(half) + _mm_cvtsd_f64(_mm_unpackhi_pd(half, half));
+        }
+        KOHONEN_AVX2 V from_u8(const uint8_t *p)
+        {
+            int32_t packed;
+            std::memcpy(&packed, p, 4);
+            return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+        }
+    };
+
+    template <>
+    struct Avx2<float>
+    {
+        using V = __m256;
+        static constexpr int W = 8;
+        KOHONEN_AVX2 V zero() { return _mm256_setzero_ps(); }
+        KOHONEN_AVX2 V set1(double v) { return _mm256_set1_ps(static_cast<float>(v)); }
+        KOHONEN_AVX2 V load(const float *p) { return _mm256_loadu_ps(p); }
+        KOHONEN_AVX2 void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+        KOHONEN_AVX2 V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+        KOHONEN_AVX2 V add(V a, V b) { return _mm256_add_ps(a, b); }
+        KOHONEN_AVX2 V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+        KOHONEN_AVX2 V fmadd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+        KOHONEN_AVX2 double hsum(V v)
+        {
+            __m128 half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+            __m128 pair = _mm_add_ps(half, _mm_movehl_ps(half, half));
+            return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+        }
+        KOHONEN_AVX2 V from_u8(const uint8_t *p)
+        {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+            return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        }
+    };
+
+    template <typename E>
+    struct Avx512;
+
+    template <>
+    struct Avx512<double>
+    {
+        using V = __m512d;
+        using Mask = __mmask8;
+        static constexpr int W = 8;
+        KOHONEN_AVX512 V zero() { return _mm512_setzero_pd(); }
+        KOHONEN_AVX512 V set1(double v) { return _mm512_set1_pd(v); }
+        KOHONEN_AVX512 V load(const double *p) { return _mm512_loadu_pd(p); }
+        KOHONEN_AVX512 V load(Mask m, const double *p) { return _mm512_maskz_loadu_pd(m, p); }
+        KOHONEN_AVX512 void store(double *p, V v) { _mm512_storeu_pd(p, v); }
+        KOHONEN_AVX512 V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+        KOHONEN_AVX512 V add(V a, V b) { return _mm512_add_pd(a, b); }
+        KOHONEN_AVX512 V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+        KOHONEN_AVX512 V fmadd(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); }
+        KOHONEN_AVX512 double hsum(V v) { return _mm512_reduce_add_pd(v); }
+        KOHONEN_AVX512 V from_u8(const uint8_t *p)
+        {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+            return _mm512_cvtepi32_pd(_mm256_cvtepu8_epi32(bytes));
+        }
+    };
+
+    template <>
+    struct Avx512<float>
+    {
+        using V = __m512;
+        using Mask = __mmask16;
+        static constexpr int W = 16;
+        KOHONEN_AVX512 V zero() { return _mm512_setzero_ps(); }
+        KOHONEN_AVX512 V set1(double v) { return _mm512_set1_ps(static_cast<float>(v)); }
+        KOHONEN_AVX512 V load(const float *p) { return _mm512_loadu_ps(p); }
+        KOHONEN_AVX512 V load(Mask m, const float *p) { return _mm512_maskz_loadu_ps(m, p); }
+        KOHONEN_AVX512 void store(float *p, V v) { _mm512_storeu_ps(p, v); }
+        KOHONEN_AVX512 V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+        KOHONEN_AVX512 V add(V a, V b) { return _mm512_add_ps(a, b); }
+        KOHONEN_AVX512 V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+        KOHONEN_AVX512 V fmadd(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); }
+        KOHONEN_AVX512 double hsum(V v) { return _mm512_reduce_add_ps(v); }
+        KOHONEN_AVX512 V from_u8(const uint8_t *p)
+        {
+            return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))));
+        }
+    };
+
+    // Resto escalar compartido por las variantes SIMD
+    template <typename E>
+    inline double tail_sq(const E *x, const E *w, size_t from, size_t n, double d)
+    {
+        for (size_t i = from; i < n; ++i)
+        {
+            double diff = x[i] - w[i];
+            d += diff * diff;
+        }
+        return d;
+    }
+
+    // --- SSE2: 2 acumuladores (2 registros por iteración) ---
+    template <typename E, int K, size_t N = 0>
+    __attribute__((target("sse2"))) void l2sq_sse2(const E *x, const E *w, size_t stride, size_t len, double *out)
+    {
+        const size_t n = N ? N : len;
+        using S = Sse2<E>;
+        constexpr int W = S::W;
+        typename S::V acc0[K], acc1[K];
+        for (int k = 0; k < K; ++k)
+            acc0[k] = acc1[k] = S::zero();
+
+        size_t i = 0;
+        for (; i + 2 * W <= n; i += 2 * W)
+        {
+            typename S::V x0 = S::load(x + i);
+            typename S::V x1 = S::load(x + i + W);
+            for (int k = 0; k < K; ++k)
+            {
+                const E *wk = w + k * stride;
+                acc0[k] = S::sq_acc(S::sub(x0, S::load(wk + i)), acc0[k]);
+                acc1[k] = S::sq_acc(S::sub(x1, S::load(wk + i + W)), acc1[k]);
+            }
+        }
+
+        for (int k = 0; k < K; ++k)
+        {
+            const double d = S::hsum(S::add(acc0[k], acc1[k]));
+            out[k] = N > 0 && N % (2 * W) == 0 ? d : tail_sq(x, w + k * stride, i, n, d);
+        }
+    }
+
+    // --- AVX2 + FMA: 2 acumuladores (una línea de caché por iteración) ---
+    template <typename E, int K, size_t N = 0>
+    __attribute__((target("avx2,fma"))) void l2sq_avx2(const E *x, const E *w, size_t stride, size_t len, double *out)
+    {
+        const size_t n = N ? N : len;
+        using S = Avx2<E>;
+        constexpr int W = S::W;
+        typename S::V acc0[K], acc1[K];
+        for (int k = 0; k < K; ++k)
+            acc0[k] = acc1[k] = S::zero();
+
+        size_t i = 0;
+        for (; i + 2 * W <= n; i += 2 * W)
+        {
+            typename S::V x0 = S::load(x + i);
+            typename S::V x1 = S::load(x + i + W);
+            for (int k = 0; k < K; ++k)
+            {
+                const E *wk = w + k * stride;
+                typename S::V d0 = S::sub(x0, S::load(wk + i));
+                typename S::V d1 = S::sub(x1, S::load(wk + i + W));
+                acc0[k] = S::fmadd(d0, d0, acc0[k]);
+                acc1[k] = S::fmadd(d1, d1, acc1[k]);
+            }
+        }
+
+        for (int k = 0; k < K; ++k)
+        {
+            const double d = S::hsum(S::add(acc0[k], acc1[k]));
+            out[k] = N > 0 && N % (2 * W) == 0 ? d : tail_sq(x, w + k * stride, i, n, d);
+        }
+    }
+
+    template <typename E, int MR, int NR>
+    __attribute__((target("avx2,fma"))) void dot_avx2(const E *X, size_t ldx, const E *W, size_t ldw, size_t n, double *C, size_t ldc, bool accumulate)
+    {
+        using S = Avx2<E>;
+        typename S::V acc[MR][NR];
+        for (int a = 0; a < MR; ++a)
+            for (int b = 0; b < NR; ++b)
+                acc[a][b] = S::zero();
+
+        size_t i = 0;
+        for (; i + S::W <= n; i += S::W)
+        {
+            typename S::V xv[MR];
+            for (int a = 0; a < MR; ++a)
+                xv[a] = S::load(X + a * ldx + i);
+            for (int b = 0; b < NR; ++b)
+            {
+                typename S::V wv = S::load(W + b * ldw + i);
+                for (int a = 0; a < MR; ++a)
+                    acc[a][b] = S::fmadd(xv[a], wv, acc[a][b]);
+            }
+        }
+
+        for (int a = 0; a < MR; ++a)
+            for (int b = 0; b < NR; ++b)
+            {
+                double d = S::hsum(acc[a][b]);
+                for (size_t j = i; j < n; ++j)
+                    d += static_cast<double>(X[a * ldx + j]) * W[b * ldw + j];
+                C[a * ldc + b] = accumulate ? C[a * ldc + b] + d : d;
+            }
+    }
+
+    // Un registro acumulador por bloque; la suma parcial se reduce y se
+    // compara con la cota al terminar cada bloque
+    template <typename E>
+    __attribute__((target("avx2,fma"))) double l2sq_bounded_avx2(const E *x, const E *w, const uint32_t *blocks, size_t n_blocks,
+                                                            size_t n, double bound, size_t &evaluated)
+    {
+        using S = Avx2<E>;
+        constexpr int W = S::W;
+        constexpr size_t BLOCK = kernels::BOUNDED_BLOCK;
+        double d = 0.0;
+        size_t done = 0;
+        for (size_t b = 0; b < n_blocks; ++b)
+        {
+            const size_t from = blocks[b];
+            if (from + BLOCK <= n)
+            {
+                typename S::V acc = S::zero();
+                for (size_t j = 0; j < BLOCK; j += W)
+                {
+                    typename S::V diff = S::sub(S::load(x + from + j), S::load(w + from + j));
+                    acc = S::fmadd(diff, diff, acc);
+                }
+                d += S::hsum(acc);
+                done += BLOCK;
+            }
+            else
+            {
+                d = tail_sq(x, w, from, n, d);
+                done += n - from;
+            }
+            if (d > bound)
+                break;
+        }
+        evaluated = done;
+        return d;
+    }
+
+    // Un gather de W índices por iteración; el resto en escalar
+    template <typename E>
+    __attribute__((target("avx2,fma"))) double sparse_dot_avx2(const uint32_t *idx, const E *val, size_t nnz, const E *w)
+    {
+        using S = Avx2<E>;
+        typename S::V acc = S::zero();
+        size_t k = 0;
+        for (; k + S::W <= nnz; k += S::W)
+        {
+            typename S::V gathered;
+            if constexpr (std::is_same_v<E, float>)
+                gathered = _mm256_i32gather_ps(w, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(idx + k)), 4);
+            else
+                gathered = _mm256_i32gather_pd(w, _mm_loadu_si128(reinterpret_cast<const __m128i *>(idx + k)), 8);
+            acc = S::fmadd(S::load(val + k), gathered, acc);
+        }
+        double d = S::hsum(acc);
+        for (; k < nnz; ++k)
+            d += static_cast<double>(val[k]) * w[idx[k]];
+        return d;
+    }
+
+    template <typename E>
+    __attribute__((target("avx2,fma"))) void axpy_avx2(double a, const E *x, size_t n, E *y)
+    {
+        using S = Avx2<E>;
+        const typename S::V va = S::set1(a);
+        size_t i = 0;
+        for (; i + S::W <= n; i += S::W)
+            S::store(y + i, S::fmadd(va, S::load(x + i), S::load(y + i)));
+        for (; i < n; ++i)
+            y[i] += static_cast<E>(a) * x[i];
+    }
+
+    template <typename E>
+    __attribute__((target("avx2,fma"))) void widen_u8_avx2(const uint8_t *src, size_t n, double scale, E *dst)
+    {
+        using S = Avx2<E>;
+        const typename S::V vs = S::set1(scale);
+        size_t i = 0;
+        for (; i + S::W <= n; i += S::W)
+            S::store(dst + i, S::mul(S::from_u8(src + i), vs));
+        for (; i < n; ++i)
+            dst[i] = static_cast<E>(src[i] * scale);
+    }
+
+    // --- AVX-512: 2 acumuladores, resto con carga enmascarada ---
+    template <typename E, int K, size_t N = 0>
+    __attribute__((target("avx512f"))) void l2sq_avx512(const E *x, const E *w, size_t stride, size_t len, double *out)
+    {
+        const size_t n = N ? N : len;
+        using S = Avx512<E>;
+        constexpr int W = S::W;
+        typename S::V acc0[K], acc1[K];
+        for (int k = 0; k < K; ++k)
+            acc0[k] = acc1[k] = S::zero();
+
+        size_t i = 0;
+        for (; i + 2 * W <= n; i += 2 * W)
+        {
+            typename S::V x0 = S::load(x + i);
+            typename S::V x1 = S::load(x + i + W);
+            for (int k = 0; k < K; ++k)
+            {
+                const E *wk = w + k * stride;
+                typename S::V d0 = S::sub(x0, S::load(wk + i));
+                typename S::V d1 = S::sub(x1, S::load(wk + i + W));
+                acc0[k] = S::fmadd(d0, d0, acc0[k]);
+                acc1[k] = S::fmadd(d1, d1, acc1[k]);
+            }
+        }
+        for (; i < n; i += W)
+        {
+            using Mask = typename S::Mask;
+            Mask mask = n - i >= W ? static_cast<Mask>(~0u) : static_cast<Mask>((1u << (n - i)) - 1);
+            typename S::V xv = S::load(mask, x + i);
+            for (int k = 0; k < K; ++k)
+            {
+                typename S::V d = S::sub(xv, S::load(mask, w + k * stride + i));
+                acc0[k] = S::fmadd(d, d, acc0[k]);
+            }
+        }
+
+        for (int k = 0; k < K; ++k)
+            out[k] = S::hsum(S::add(acc0[k], acc1[k]));
+    }
+
+    template <typename E, int MR, int NR>
+    __attribute__((target("avx512f"))) void dot_avx512(const E *X, size_t ldx, const E *W, size_t ldw, size_t n, double *C, size_t ldc, bool accumulate)
+    {
+        using S = Avx512<E>;
+        typename S::V acc[MR][NR];
+        for (int a = 0; a < MR; ++a)
+            for (int b = 0; b < NR; ++b)
+                acc[a][b] = S::zero();
+
+        size_t i = 0;
+        for (; i + S::W <= n; i += S::W)
+        {
+            typename S::V xv[MR];
+            for (int a = 0; a < MR; ++a)
+                xv[a] = S::load(X + a * ldx + i);
+            for (int b = 0; b < NR; ++b)
+            {
+                typename S::V wv = S::load(W + b * ldw + i);
+                for (int a = 0; a < MR; ++a)
+                    acc[a][b] = S::fmadd(xv[a], wv, acc[a][b]);
+            }
+        }
+        if (i < n)
+        {
+            auto mask = static_cast<typename S::Mask>((1u << (n - i)) - 1);
+            typename S::V xv[MR];
+            for (int a = 0; a < MR; ++a)
+                xv[a] = S::load(mask, X + a * ldx + i);
+            for (int b = 0; b < NR; ++b)
+            {
+                typename S::V wv = S::load(mask, W + b * ldw + i);
+                for (int a = 0; a < MR; ++a)
+                    acc[a][b] = S::fmadd(xv[a], wv, acc[a][b]);
+            }
+        }
+
+        for (int a = 0; a < MR; ++a)
+            for (int b = 0; b < NR; ++b)
+            {
+                double d = S::hsum(acc[a][b]);
+                C[a * ldc + b] = accumulate ? C[a * ldc + b] + d : d;
+            }
+    }
+
+    // Un registro acumulador por bloque; la suma parcial se reduce y se
+    // compara con la cota al terminar cada bloque
+    template <typename E>
+    __attribute__((target("avx512f"))) double l2sq_bounded_avx512(const E *x, const E *w, const uint32_t *blocks, size_t n_blocks,
+                                                            size_t n, double bound, size_t &evaluated)
+    {
+        using S = Avx512<E>;
+        constexpr int W = S::W;
+        constexpr size_t BLOCK = kernels::BOUNDED_BLOCK;
+        double d = 0.0;
+        size_t done = 0;
+        for (size_t b = 0; b < n_blocks; ++b)
+        {
+            const size_t from = blocks[b];
+            if (from + BLOCK <= n)
+            {
+                typename S::V acc = S::zero();
+                for (size_t j = 0; j < BLOCK; j += W)
+                {
+                    typename S::V diff = S::sub(S::load(x + from + j), S::load(w + from + j));
+                    acc = S::fmadd(diff, diff, acc);
+                }
+                d += S::hsum(acc);
+                done += BLOCK;
+            }
+            else
+            {
+                d = tail_sq(x, w, from, n, d);
+                done += n - from;
+            }
+            if (d > bound)
+                break;
+        }
+        evaluated = done;
+        return d;
+    }
+
+    // Un gather de W índices por iteración; el resto con máscara
+    template <typename E>
+    __attribute__((target("avx512f"))) double sparse_dot_avx512(const uint32_t *idx, const E *val, size_t nnz, const E *w)
+    {
+        using S = Avx512<E>;
+        typename S::V acc = S::zero();
+        size_t k = 0;
+        for (; k < nnz; k += S::W)
+        {
+            const typename S::Mask m = nnz - k >= static_cast<size_t>(S::W)
+                                           ? static_cast<typename S::Mask>(~0u)
+                                           : static_cast<typename S::Mask>((1u << (nnz - k)) - 1);
+            typename S::V gathered;
+            if constexpr (std::is_same_v<E, float>)
+                gathered = _mm512_mask_i32gather_ps(S::zero(), m, _mm512_maskz_loadu_epi32(m, idx + k), w, 4);
+            else
+                gathered = _mm512_mask_i32gather_pd(S::zero(), m, _mm512_castsi512_si256(_mm512_maskz_loadu_epi32(m, idx + k)), w, 8);
+            acc = S::fmadd(S::load(m, val + k), gathered, acc);
+        }
+        return S::hsum(acc);
+    }
+
+    template <typename E>
+    __attribute__((target("avx512f"))) void axpy_avx512(double a, const E *x, size_t n, E *y)
+    {
+        using S = Avx512<E>;
+        const typename S::V va = S::set1(a);
+        size_t i = 0;
+        for (; i + S::W <= n; i += S::W)
+            S::store(y + i, S::fmadd(va, S::load(x + i), S::load(y + i)));
+        for (; i < n; ++i)
+            y[i] += static_cast<E>(a) * x[i];
+    }
+
+    template <typename E>
+    __attribute__((target("avx512f"))) void widen_u8_avx512(const uint8_t *src, size_t n, double scale, E *dst)
+    {
+        using S = Avx512<E>;
+        const typename S::V vs = S::set1(scale);
+        size_t i = 0;
+        for (; i + S::W <= n; i += S::W)
+            S::store(dst + i, S::mul(S::from_u8(src + i), vs));
+        for (; i < n; ++i)
+            dst[i] = static_cast<E>(src[i] * scale);
+    }
+
+#undef KOHONEN_SSE2
+#undef KOHONEN_AVX2
+#undef KOHONEN_AVX512
+#endif
+
+    template <typename E>
+    using DotBlock = void (*)(const E *, size_t, const E *, size_t, size_t, double *, size_t, bool);
+
+    // Micro-kernel principal (mr x nr) y los de borde (1 x nr, mr x 1, 1 x 1)
+    template <typename E>
+    struct DotKernels
+    {
+        int mr, nr;
+        DotBlock<E> full, row_edge, col_edge, single;
+    };
+
+    template <typename E>
+    using DistanceKernel = void (*)(const E *, const E *, size_t, size_t, double *);
+
+    // l2sq y l2sq_x4 especializados para cada una de kernels::FIXED_DIMS
+    // (KOHONEN_FIXED las recorre en el mismo orden)
+    template <typename E>
+    struct FixedKernels
+    {
+        DistanceKernel<E> one, four;
+    };
+
+#define KOHONEN_FIXED(kernel)                                                                       \
+    {                                                                                               \
+        {{kernel<E, 1, 64>, kernel<E, 4, 64>}, {kernel<E, 1, 128>, kernel<E, 4, 128>},              \
+         {kernel<E, 1, 256>, kernel<E, 4, 256>}, {kernel<E, 1, 784>, kernel<E, 4, 784>}}            \
+    }
+
+    // Kernels seleccionados para un tipo de elemento
+    template <typename E>
+    struct KernelSet
+    {
+        DistanceKernel<E> one, four;
+        DotKernels<E> dot;
+        void (*widen)(const uint8_t *, size_t, double, E *);
+        double (*bounded)(const E *, const E *, const uint32_t *, size_t, size_t, double, size_t &);
+        double (*sparse)(const uint32_t *, const E *, size_t, const E *);
+        void (*axpy)(double, const E *, size_t, E *);
+        std::array<FixedKernels<E>, std::size(kernels::FIXED_DIMS)> fixed;
+    };
+
+    struct Dispatch
+    {
+        const char *name;
+        KernelSet<double> f64;
+        KernelSet<float> f32;
+
+        const KernelSet<double> &get(const double *) const { return f64; }
+        const KernelSet<float> &get(const float *) const { return f32; }
+    };
+
+    template <typename E>
+    KernelSet<E> scalar_set()
+    {
+        return {l2sq_scalar<E, 1>, l2sq_scalar<E, 4>,
+                {2, 2, dot_scalar<E, 2, 2>, dot_scalar<E, 1, 2>, dot_scalar<E, 2, 1>, dot_scalar<E, 1, 1>},
+                widen_u8_scalar<E>, l2sq_bounded_scalar<E>, sparse_dot_scalar<E>, axpy_scalar<E>,
+                KOHONEN_FIXED(l2sq_scalar)};
+    }
+
+#ifdef KOHONEN_X86
+    // El bloque de registros depende del ISA: 4x4 acumuladores con 32
+    // registros zmm, 2x4 con los 16 registros ymm de AVX2
+    template <typename E>
+    KernelSet<E> avx512_set()
+    {
+        return {l2sq_avx512<E, 1>, l2sq_avx512<E, 4>,
+                {4, 4, dot_avx512<E, 4, 4>, dot_avx512<E, 1, 4>, dot_avx512<E, 4, 1>, dot_avx512<E, 1, 1>},
+                widen_u8_avx512<E>, l2sq_bounded_avx512<E>, sparse_dot_avx512<E>, axpy_avx512<E>,
+                KOHONEN_FIXED(l2sq_avx512)};
+    }
+
+    template <typename E>
+    KernelSet<E> avx2_set()
+    {
+        return {l2sq_avx2<E, 1>, l2sq_avx2<E, 4>,
+                {2, 4, dot_avx2<E, 2, 4>, dot_avx2<E, 1, 4>, dot_avx2<E, 2, 1>, dot_avx2<E, 1, 1>},
+                widen_u8_avx2<E>, l2sq_bounded_avx2<E>, sparse_dot_avx2<E>, axpy_avx2<E>,
+                KOHONEN_FIXED(l2sq_avx2)};
+    }
+
+    template <typename E>
+    KernelSet<E> sse2_set()
+    {
+        KernelSet<E> set = scalar_set<E>();
+        set.one = l2sq_sse2<E, 1>;
+        set.four = l2sq_sse2<E, 4>;
+        set.fixed = KOHONEN_FIXED(l2sq_sse2);
+        return set;
+    }
+#endif
+
+    Dispatch select_kernels()
+    {
+        // Orden de preferencia; KOHONEN_ISA limita la implementación más alta permitida
+        const char *forced = std::getenv("KOHONEN_ISA");
+        bool allowed = forced == nullptr || *forced == '\0';
+        auto permit = [&](const char *name)
+        {
+            if (!allowed && std::strcmp(forced, name) == 0)
+                allowed = true;
+            return allowed;
+        };
+
+#ifdef KOHONEN_X86
+        __builtin_cpu_init();
+        if (permit("avx512") && __builtin_cpu_supports("avx512f"))
+            return {"avx512", avx512_set<double>(), avx512_set<float>()};
+        if (permit("avx2") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return {"avx2", avx2_set<double>(), avx2_set<float>()};
+        if (permit("sse2") && __builtin_cpu_supports("sse2"))
+            return {"sse2", sse2_set<double>(), sse2_set<float>()};
+#endif
+        return {"scalar", scalar_set<double>(), scalar_set<float>()};
+    }
+
+#undef KOHONEN_FIXED
+
+    const Dispatch &dispatch()
+    {
+        static const Dispatch selected = select_kernels();
+        return selected;
+    }
+
+    template <typename E>
+    void dot_nt_impl(const E *X, size_t ldx, size_t m, const E *W, size_t ldw, size_t nw,
+                     size_t n, double *C, size_t ldc, bool accumulate)
+    {
+        const DotKernels<E> &k = dispatch().get(X).dot;
+        size_t a = 0;
+        for (; a + k.mr <= m; a += k.mr)
+        {
+            size_t b = 0;
+            for (; b + k.nr <= nw; b += k.nr)
+                k.full(X + a * ldx, ldx, W + b * ldw, ldw, n, C + a * ldc + b, ldc, accumulate);
+            for (; b < nw; ++b)
+                k.col_edge(X + a * ldx, ldx, W + b * ldw, ldw, n, C + a * ldc + b, ldc, accumulate);
+        }
+        for (; a < m; ++a)
+        {
+            size_t b = 0;
+            for (; b + k.nr <= nw; b += k.nr)
+                k.row_edge(X + a * ldx, ldx, W + b * ldw, ldw, n, C + a * ldc + b, ldc, accumulate);
+            for (; b < nw; ++b)
+                k.single(X + a * ldx, ldx, W + b * ldw, ldw, n, C + a * ldc + b, ldc, accumulate);
+        }
+    }
+}
+
+namespace kernels
+{
+    double l2sq(const double *a, const double *b, size_t n)
+    {
+        double d;
+        dispatch().f64.one(a, b, 0, n, &d);
+        return d;
+    }
+
+    double l2sq(const float *a, const float *b, size_t n)
+    {
+        double d;
+        dispatch().f32.one(a, b, 0, n, &d);
+        return d;
+    }
+
+    void l2sq_x4(const double *x, const double *w, size_t stride, size_t n, double out[4])
+    {
+        dispatch().f64.four(x, w, stride, n, out);
+    }
+
+    void l2sq_x4(const float *x, const float *w, size_t stride, size_t n, double out[4])
+    {
+        dispatch().f32.four(x, w, stride, n, out);
+    }
+
+    double l2sq_bounded(const double *a, const double *b, const uint32_t *blocks, size_t n_blocks, size_t n,
+                        double bound, size_t &evaluated)
+    {
+        return dispatch().f64.bounded(a, b, blocks, n_blocks, n, bound, evaluated);
+    }
+
+    double l2sq_bounded(const float *a, const float *b, const uint32_t *blocks, size_t n_blocks, size_t n,
+                        double bound, size_t &evaluated)
+    {
+        return dispatch().f32.bounded(a, b, blocks, n_blocks, n, bound, evaluated);
+    }
+
+    double sparse_dot(const uint32_t *idx, const double *val, size_t nnz, const double *w)
+    {
+        return dispatch().f64.sparse(idx, val, nnz, w);
+    }
+
+    double sparse_dot(const uint32_t *idx, const float *val, size_t nnz, const float *w)
+    {
+        return dispatch().f32.sparse(idx, val, nnz, w);
+    }
+
+    void axpy(double a, const double *x, size_t n, double *y)
+    {
+        dispatch().f64.axpy(a, x, n, y);
+    }
+
+    void axpy(double a, const float *x, size_t n, float *y)
+    {
+        dispatch().f32.axpy(a, x, n, y);
+    }
+
+    void lerp_shared(double a, const double *x, size_t n, double *w, double *local)
+    {
+        lerp_shared_scalar(a, x, n, w, local);
+    }
+
+    void lerp_shared(double a, const float *x, size_t n, float *w, float *local)
+    {
+        lerp_shared_scalar(a, x, n, w, local);
+    }
+
+    void load_shared(const double *w, size_t n, double *out)
+    {
+        load_relaxed(w, n, out);
+    }
+
+    void load_shared(const float *w, size_t n, float *out)
+    {
+        load_relaxed(w, n, out);
+    }
+
+    void dot_nt(const double *X, size_t ldx, size_t m, const double *W, size_t ldw, size_t nw,
+                size_t n, double *C, size_t ldc, bool accumulate)
+    {
+        dot_nt_impl(X, ldx, m, W, ldw, nw, n, C, ldc, accumulate);
+    }
+
+    void dot_nt(const float *X, size_t ldx, size_t m, const float *W, size_t ldw, size_t nw,
+                size_t n, double *C, size_t ldc, bool accumulate)
+    {
+        dot_nt_impl(X, ldx, m, W, ldw, nw, n, C, ldc, accumulate);
+    }
+
+    void widen_u8(const uint8_t *src, size_t n, double scale, double *dst)
+    {
+        dispatch().f64.widen(src, n, scale, dst);
+    }
+
+    void widen_u8(const uint8_t *src, size_t n, double scale, float *dst)
+    {
+        dispatch().f32.widen(src, n, scale, dst);
+    }
+
+    const char *isa_name()
+    {
+        return dispatch().name;
+    }
+
+    template <typename E>
+    DimKernels<E> for_dim(size_t n, bool specialize)
+    {
+        const KernelSet<E> &set = dispatch().get(static_cast<const E *>(nullptr));
+        DimKernels<E> k{set.one, set.four, n, false};
+        if (!specialize)
+            return k;
+        for (size_t d = 0; d < std::size(FIXED_DIMS); ++d)
+            if (FIXED_DIMS[d] == n)
+                k = {set.fixed[d].one, set.fixed[d].four, n, true};
+        return k;
+    }
+
+    template DimKernels<double> for_dim<double>(size_t, bool);
+    template DimKernels<float> for_dim<float>(size_t, bool);
+}
@@ -1,208 +1,1695 @@
 #include "RedKohonen.hpp"
+#include "Kernels.hpp"
+#include "Trace.hpp"
 #include "Utils.hpp"
 #include <cmath>
 #include <fstream>
 #include <iostream>
-#include <limits>
 #include <sstream>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
 #include <omp.h>
-#include <cctype>
 #include <filesystem>
+#include <future>
 #include <iomanip>
 
-void RedKohonen::set_validation_data(const std::vector<std::vector<double>> &X_val, const std::vector<int> &Y_val)
+template <typename T>
+template <typename S>
+void BasicRedKohonen<T>::set_validation_data(Matrix<S> X_val, const std::vector<int> &Y_val)
+{
+    X_val_data = std::move(X_val);
+    Y_val_labels = Y_val;
+    validation_enabled = true;
+    val_bounds.clear();
+}
+
+template <typename T>
+BasicRedKohonen<T>::BasicRedKohonen(const BasicRedKohonen &coarse, int dX, int dY, int dZ, double initialLR,
+                                    int numEpochs, double start_radius)
+    : BasicRedKohonen(coarse.input_dim, dX, dY, dZ, 0.0, numEpochs, coarse.mode, coarse.algorithm, start_radius)
+{
+    initial_learning_rate = initialLR;
+
+    // Posición de cada plano de la malla fina en la gruesa: índice inferior y peso del superior
+    auto axis = [](int fine, int coarse_dim)
+    {
+        std::vector<std::pair<int, double>> map(fine);
+        for (int i = 0; i < fine; ++i)
+        {
+            const double u = fine > 1 ? static_cast<double>(i) * (coarse_dim - 1) / (fine - 1) : 0.0;
+            const int lo = std::min(static_cast<int>(u), std::max(0, coarse_dim - 2));
+            map[i] = {lo, coarse_dim > 1 ? u - lo : 0.0};
+        }
+        return map;
+    };
+    const auto mx = axis(dim_x, coarse.dim_x), my = axis(dim_y, coarse.dim_y), mz = axis(dim_z, coarse.dim_z);
+    const int step_x = coarse.dim_x > 1 ? 1 : 0;
+    const int step_y = coarse.dim_y > 1 ? coarse.dim_x : 0;
+    const int step_z = coarse.dim_z > 1 ? coarse.dim_x * coarse.dim_y : 0;
+
+#pragma omp parallel
+    {
+        std::vector<double> acc(input_dim);
+#pragma omp for schedule(static)
+        for (int i = 0; i < total_neurons; ++i)
+        {
+            auto [x, y, z] = lattice_coords(i);
+            const auto [x0, fx] = mx[x];
+            const auto [y0, fy] = my[y];
+            const auto [z0, fz] = mz[z];
+            const int base = x0 + coarse.dim_x * (y0 + coarse.dim_y * z0);
+
+            std::fill(acc.begin(), acc.end(), 0.0);
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                const int cx = corner & 1, cy = (corner >> 1) & 1, cz = corner >> 2;
+                const double weight = (cx ? fx : 1.0 - fx) * (cy ? fy : 1.0 - fy) * (cz ? fz : 1.0 - fz);
+                if (weight == 0.0)
+                    continue;
+                const T *w = coarse.codebook.row(base + cx * step_x + cy * step_y + cz * step_z);
+                for (int d = 0; d < input_dim; ++d)
+                    acc[d] += weight * w[d];
+            }
+            T *out = codebook.row(i);
+            for (int d = 0; d < input_dim; ++d)
+                out[d] = static_cast<T>(acc[d]);
+
+            // Etiqueta de la neurona gruesa más cercana, hasta la primera validación
+            const int nearest = base + (fx >= 0.5) * step_x + (fy >= 0.5) * step_y + (fz >= 0.5) * step_z;
+            labels[i] = coarse.labels[nearest];
+        }
+    }
+    refresh_norms();
+}
+
+template <typename T>
+void BasicRedKohonen<T>::set_validation_data(SparseMatrix<T> X_val, const std::vector<int> &Y_val)
 {
-    X_val_data = X_val;
+    X_val_data = std::move(X_val);
     Y_val_labels = Y_val;
     validation_enabled = true;
+    val_bounds.clear();
+}
+
+template <typename T>
+void BasicRedKohonen<T>::set_validation_data(const std::vector<std::vector<double>> &X_val, const std::vector<int> &Y_val)
+{
+    set_validation_data(Matrix<T>::from_rows(X_val), Y_val);
 }
 
-int RedKohonen::predict(const std::vector<double> &x) const
+template <typename T>
+int BasicRedKohonen<T>::predict(const std::vector<T> &x) const
 {
     int bmu_idx = find_bmu(x);
-    return neurons[bmu_idx].get_label();
+    return labels[bmu_idx];
 }
 
-std::pair<int, std::tuple<int, int, int>> RedKohonen::predict_with_coords(const std::vector<double> &x) const
+template <typename T>
+std::pair<int, std::tuple<int, int, int>> BasicRedKohonen<T>::predict_with_coords(const std::vector<T> &x) const
 {
     int idx = find_bmu(x);
-    int z = idx / (dim_x * dim_y);
-    int y = (idx % (dim_x * dim_y)) / dim_x;
-    int x_ = idx % dim_x;
-    return {neurons[idx].get_label(), {x_, y, z}};
+    return {labels[idx], lattice_coords(idx)};
 }
 
-std::tuple<int, int, int> RedKohonen::find_bmu_coords(const std::vector<double> &input) const
+template <typename T>
+std::tuple<int, int, int> BasicRedKohonen<T>::find_bmu_coords(const std::vector<T> &input) const
 {
-    int idx = find_bmu(input);
-    int z = idx / (dim_x * dim_y);
-    int y = (idx % (dim_x * dim_y)) / dim_x;
-    int x = idx % dim_x;
-    return {x, y, z};
+    return lattice_coords(find_bmu(input));
 }
 
-int RedKohonen::find_bmu(const std::vector<double> &input) const
+template <typename T>
+int BasicRedKohonen<T>::find_bmu(const std::vector<T> &input) const
 {
-    int bmu_idx = 0;
-    double min_dist = std::numeric_limits<double>::max();
+    if (bmu_search == BmuSearch::PARTIAL_DISTANCE)
+    {
+        size_t dims = 0;
+        return find_bmu_partial(input.data(), 0, total_neurons, -1, dims).index;
+    }
+    return find_bmu_in_range(input.data(), 0, total_neurons).index;
+}
 
+template <typename T>
+void BasicRedKohonen<T>::refresh_norms()
+{
+    prototype_norms.resize(total_neurons);
+#pragma omp parallel for
     for (int i = 0; i < total_neurons; ++i)
     {
-        double d = neurons[i].distance_sq(input);
-        if (d < min_dist)
+        const T *w = codebook.row(i);
+        kernels::dot_nt(w, 0, 1, w, 0, 1, input_dim, &prototype_norms[i], 1);
+    }
+}
+
+// Búsqueda de BMUs por lotes como producto de matrices:
+//   ||x - w||^2 = ||x||^2 - 2 x.w + ||w||^2
+// Se recorren tiles de muestras x tiles de neuronas para que ambos bloques
+// permanezcan en caché mientras el micro-kernel calcula los productos punto.
+// Las muestras de 8 bits se convierten una vez por tile de muestras, no por
+// cada tile de neuronas que las recorre.
+template <typename T>
+template <typename S>
+void BasicRedKohonen<T>::find_bmu_batch(const Matrix<S> &X, std::span<int> out, std::span<double> dist_sq) const
+{
+    constexpr int SAMPLE_TILE = 64;
+    constexpr int NEURON_TILE = 64;
+    constexpr int DIM_TILE = 256;
+    const int n_samples = static_cast<int>(X.rows());
+    TRACE_SCOPE("find_bmu_batch");
+    TRACE_COUNT(DISTANCES, static_cast<uint64_t>(n_samples) * total_neurons);
+
+#pragma omp parallel
+    {
+        std::vector<double> scores(SAMPLE_TILE * NEURON_TILE);
+        std::vector<double> best(SAMPLE_TILE);
+        Matrix<T> decoded;
+        if constexpr (!std::is_same_v<S, T>)
+            decoded = Matrix<T>(SAMPLE_TILE, input_dim);
+
+#pragma omp for schedule(dynamic)
+        for (int s0 = 0; s0 < n_samples; s0 += SAMPLE_TILE)
         {
-            min_dist = d;
-            bmu_idx = i;
+            int m = std::min(SAMPLE_TILE, n_samples - s0);
+            std::fill(best.begin(), best.end(), std::numeric_limits<double>::max());
+
+            const T *tile;
+            size_t ld;
+            if constexpr (std::is_same_v<S, T>)
+            {
+                tile = X.row(s0);
+                ld = X.stride();
+            }
+            else
+            {
+                for (int a = 0; a < m; ++a)
+                    decode_sample(X.row(s0 + a), input_dim, decoded.row(a));
+                tile = decoded.data();
+                ld = decoded.stride();
+            }
+
+            for (int n0 = 0; n0 < total_neurons; n0 += NEURON_TILE)
+            {
+                int nw = std::min(NEURON_TILE, total_neurons - n0);
+                for (int k0 = 0; k0 < input_dim; k0 += DIM_TILE)
+                    kernels::dot_nt(tile + k0, ld, m, codebook.row(n0) + k0, codebook.stride(), nw,
+                                    std::min(DIM_TILE, input_dim - k0), scores.data(), NEURON_TILE, k0 > 0);
+
+                // ||x||^2 es constante en cada fila y no cambia el argmin
+                for (int a = 0; a < m; ++a)
+                {
+                    const double *row = scores.data() + a * NEURON_TILE;
+                    for (int b = 0; b < nw; ++b)
+                    {
+                        double d = prototype_norms[n0 + b] - 2.0 * row[b];
+                        if (d < best[a])
+                        {
+                            best[a] = d;
+                            out[s0 + a] = n0 + b;
+                        }
+                    }
+                }
+            }
+
+            if (!dist_sq.empty())
+            {
+                for (int a = 0; a < m; ++a)
+                {
+                    double x_norm;
+                    const T *x = tile + a * ld;
+                    kernels::dot_nt(x, 0, 1, x, 0, 1, input_dim, &x_norm, 1);
+                    dist_sq[s0 + a] = std::max(0.0, x_norm + best[a]);
+                }
+            }
         }
     }
-    return bmu_idx;
 }
 
-void RedKohonen::assign_labels(const std::vector<std::vector<double>> &X_val, const std::vector<int> &Y_val)
+// Búsqueda de BMUs por lotes con muestras dispersas:
+//   ||x - w||^2 = ||x||^2 + ||w||^2 - 2 sum_k x_k w_k   (k: entradas no nulas)
+// Los productos se acumulan sobre el codebook traspuesto: cada entrada no nula
+// suma x_k * (fila k de W^T) a las puntuaciones de todas las neuronas, un
+// recorrido contiguo en lugar de un gather por neurona.
+template <typename T>
+void BasicRedKohonen<T>::find_bmu_batch(const SparseMatrix<T> &X, std::span<int> out, std::span<double> dist_sq) const
 {
-    std::vector<std::vector<int>> hits(total_neurons);
-    for (size_t i = 0; i < X_val.size(); ++i)
+    const int n_samples = static_cast<int>(X.rows());
+    TRACE_SCOPE("find_bmu_batch");
+    TRACE_COUNT(DISTANCES, static_cast<uint64_t>(n_samples) * total_neurons);
+    Matrix<T> transposed(input_dim, total_neurons);
+#pragma omp parallel for
+    for (int j = 0; j < input_dim; ++j)
     {
-        int bmu_idx = find_bmu(X_val[i]);
-        hits[bmu_idx].push_back(Y_val[i]);
+        T *dst = transposed.row(j);
+        for (int i = 0; i < total_neurons; ++i)
+            dst[i] = codebook.row(i)[j];
     }
 
-#pragma omp parallel for
-    for (int i = 0; i < total_neurons; ++i)
+#pragma omp parallel
     {
-        if (!hits[i].empty())
+        std::vector<T> scores(total_neurons);
+
+#pragma omp for schedule(dynamic, 64)
+        for (int s = 0; s < n_samples; ++s)
         {
-            std::vector<int> counts(10, 0);
-            for (int label : hits[i])
+            const auto x = X.row(s);
+            std::fill(scores.begin(), scores.end(), T(0));
+            for (size_t k = 0; k < x.nnz; ++k)
+                kernels::axpy(x.val[k], transposed.row(x.idx[k]), total_neurons, scores.data());
+
+            double best = std::numeric_limits<double>::max();
+            for (int i = 0; i < total_neurons; ++i)
             {
-                counts[label]++;
+                double d = prototype_norms[i] - 2.0 * scores[i];
+                if (d < best)
+                {
+                    best = d;
+                    out[s] = i;
+                }
             }
-            int majority_label = std::distance(counts.begin(), std::max_element(counts.begin(), counts.end()));
-            neurons[i].set_label(majority_label);
+            if (!dist_sq.empty())
+                dist_sq[s] = std::max(0.0, x.norm_sq + best);
         }
     }
 }
 
-void RedKohonen::train(int epoch, const std::vector<std::vector<double>> &X_train, std::ofstream *log_file)
+template <typename T>
+void BasicRedKohonen<T>::assign_labels(const std::vector<std::vector<double>> &X_val, const std::vector<int> &Y_val)
 {
-    auto start = start_timer();
+    assign_labels(Matrix<T>::from_rows(X_val), Y_val);
+}
 
-    double current_lr = initial_learning_rate;
-    double current_radius = initial_radius;
-    double radius_sq = current_radius * current_radius;
+template <typename T>
+template <typename Samples>
+void BasicRedKohonen<T>::assign_labels(const Samples &X_val, const std::vector<int> &Y_val)
+{
+    TRACE_SCOPE("assign_labels");
+    evaluate(X_val, Y_val);
+}
 
-    if (mode == NeighborhoodMode::GAUSSIAN_RADIUS || mode == NeighborhoodMode::CONSTANT_RADIUS)
+template <typename T>
+template <typename Samples>
+Evaluation BasicRedKohonen<T>::evaluate(const Samples &X_val, const std::vector<int> &Y_val)
+{
+    std::vector<int> bmus(X_val.rows());
+    std::vector<double> dist_sq(X_val.rows());
+    find_bmu_batch(X_val, bmus, dist_sq);
+    return evaluate_bmus(bmus, dist_sq, Y_val);
+}
+
+// Etiqueta cada neurona con la clase mayoritaria de las muestras cuya BMU es
+// ella y mide la precisión con esas mismas BMUs. Cada hilo cuenta en su
+// histograma plano neuronas x clases y luego se suman por neuronas. Las
+// neuronas sin muestras conservan su etiqueta. Sin dist_sq no hay error de
+// cuantización; si ninguna muestra tiene etiqueta (todas < 0), la precisión es
+// 0 y no cambia ninguna etiqueta. Si Y no tiene una etiqueta por muestra,
+// devuelve una evaluación vacía sin tocar las etiquetas.
+template <typename T>
+Evaluation BasicRedKohonen<T>::evaluate_bmus(std::span<const int> bmus, std::span<const double> dist_sq,
+                                             const std::vector<int> &Y)
+{
+    TRACE_SCOPE("evaluate");
+    Evaluation result;
+    if (Y.size() != bmus.size())
+    {
+        std::cerr << "Error: " << bmus.size() << " muestras y " << Y.size() << " etiquetas; no se evalúa." << std::endl;
+        return result;
+    }
+    if (bmus.empty())
+        return result;
+
+    const int num_classes = *std::max_element(Y.begin(), Y.end()) + 1;
+    const long n = static_cast<long>(bmus.size());
+    double qe = 0.0;
+    if (num_classes <= 0)
     {
-        current_lr = initial_learning_rate * exp(-(double)epoch / epochs);
-        current_radius = initial_radius * exp(-(double)epoch / time_constant);
-        radius_sq = current_radius * current_radius;
+        if (!dist_sq.empty())
+        {
+#pragma omp parallel for schedule(static) reduction(+ : qe)
+            for (long i = 0; i < n; ++i)
+                qe += std::sqrt(dist_sq[i]);
+            result.quantization_error = qe / n;
+        }
+        return result;
     }
-    int sample_count = 0;
-    for (const auto &sample : X_train)
+
+    const size_t stride = static_cast<size_t>(total_neurons) * num_classes;
+    const int threads = omp_get_max_threads();
+    std::vector<uint32_t> hist(threads * stride, 0);
+
+#pragma omp parallel num_threads(threads) reduction(+ : qe)
     {
-        std::cout << "Epoch " << epoch + 1 << "/" << epochs
-                  << ": " << ++sample_count << "/" << X_train.size() << "\r";
-        std::cout.flush();
+        uint32_t *local = hist.data() + omp_get_thread_num() * stride;
+#pragma omp for schedule(static)
+        for (long i = 0; i < n; ++i)
+        {
+            if (Y[i] >= 0)
+                local[static_cast<size_t>(bmus[i]) * num_classes + Y[i]]++;
+            if (!dist_sq.empty())
+                qe += std::sqrt(dist_sq[i]);
+        }
+    }
 
-        int bmu_idx = find_bmu(sample);
-        int bmu_z = bmu_idx / (dim_x * dim_y);
-        int bmu_y = (bmu_idx % (dim_x * dim_y)) / dim_x;
-        int bmu_x = bmu_idx % dim_x;
+    long correct = 0;
+#pragma omp parallel for schedule(static) reduction(+ : correct)
+    for (int j = 0; j < total_neurons; ++j)
+    {
+        uint32_t *counts = hist.data() + static_cast<size_t>(j) * num_classes;
+        for (int t = 1; t < threads; ++t)
+        {
+            const uint32_t *other = counts + t * stride;
+            for (int c = 0; c < num_classes; ++c)
+                counts[c] += other[c];
+        }
+        int majority = 0;
+        for (int c = 1; c < num_classes; ++c)
+            if (counts[c] > counts[majority])
+                majority = c;
+        if (counts[majority] > 0)
+            labels[j] = majority;
+        if (labels[j] >= 0 && labels[j] < num_classes)
+            correct += counts[labels[j]];
+    }
 
-#pragma omp parallel for
-        for (int i = 0; i < total_neurons; ++i)
+    result.accuracy = static_cast<float>(correct) / n;
+    if (!dist_sq.empty())
+        result.quantization_error = qe / n;
+    return result;
+}
+
+template <typename T>
+double BasicRedKohonen<T>::neighborhood_influence(double dist_sq, double radius_sq) const
+{
+    switch (mode)
+    {
+    case NeighborhoodMode::BMU_ONLY:
+        return dist_sq == 0.0 ? 1.0 : 0.0;
+    case NeighborhoodMode::GAUSSIAN_RADIUS:
+        return dist_sq < radius_sq ? exp(-dist_sq / (2 * radius_sq)) : 0.0;
+    case NeighborhoodMode::CONSTANT_RADIUS:
+        return dist_sq < radius_sq ? 1.0 : 0.0;
+    }
+    return 0.0;
+}
+
+// Tabla de influencia por distancia al cuadrado en la malla (entera), válida
+// para toda la época. Las colas por debajo de influence_epsilon se truncan.
+template <typename T>
+void BasicRedKohonen<T>::build_influence_table(double radius_sq)
+{
+    int reach = 0;
+    if (mode != NeighborhoodMode::BMU_ONLY)
+        reach = std::min(static_cast<int>(std::ceil(std::sqrt(radius_sq))), std::max({dim_x, dim_y, dim_z}) - 1);
+
+    influence_table.assign(3 * reach * reach + 1, 0.0);
+    for (size_t d2 = 0; d2 < influence_table.size(); ++d2)
+    {
+        double h = neighborhood_influence(static_cast<double>(d2), radius_sq);
+        influence_table[d2] = h >= influence_epsilon ? h : 0.0;
+    }
+
+    // La influencia decrece con la distancia: el alcance por eje es el mayor
+    // desplazamiento que todavía recibe actualización
+    influence_reach = 0;
+    while (influence_reach < reach && influence_table[(influence_reach + 1) * (influence_reach + 1)] > 0.0)
+        influence_reach++;
+}
+
+// Combina los candidatos de n rangos consecutivos, en orden: el resultado es
+// el mismo que el del recorrido secuencial
+template <typename T>
+typename BasicRedKohonen<T>::BmuCandidate BasicRedKohonen<T>::reduce_candidates(const BmuCandidate *slot, int n)
+{
+    BmuCandidate best = slot[0];
+    for (int t = 1; t < n; ++t)
+    {
+        if (slot[t].dist < best.dist)
         {
-            int z = i / (dim_x * dim_y);
-            int y = (i % (dim_x * dim_y)) / dim_x;
-            int x = i % dim_x;
+            best.second = std::min(best.dist, slot[t].second);
+            best.dist = slot[t].dist;
+            best.index = slot[t].index;
+        }
+        else
+            best.second = std::min(best.second, slot[t].dist);
+    }
+    return best;
+}
+
+// Mejor candidato a BMU dentro del rango de neuronas [begin, end)
+template <typename T>
+typename BasicRedKohonen<T>::BmuCandidate BasicRedKohonen<T>::find_bmu_in_range(const T *x, int begin, int end) const
+{
+    return find_bmu_in_rows(codebook, x, begin, end);
+}
 
-            double dist_to_bmu_sq = pow(x - bmu_x, 2) + pow(y - bmu_y, 2) + pow(z - bmu_z, 2);
-            switch (mode)
+// Igual, con los prototipos en W (el codebook o una copia suya)
+template <typename T>
+typename BasicRedKohonen<T>::BmuCandidate BasicRedKohonen<T>::find_bmu_in_rows(const Matrix<T> &W, const T *x,
+                                                                               int begin, int end) const
+{
+    TRACE_COUNT(DISTANCES, end - begin);
+    BmuCandidate best;
+    int i = begin;
+    double d[4];
+    for (; i + 4 <= end; i += 4)
+    {
+        distance_kernels.l2sq_x4(x, W.row(i), W.stride(), d);
+        for (int k = 0; k < 4; ++k)
+        {
+            if (d[k] < best.dist)
             {
-            case NeighborhoodMode::BMU_ONLY:
-                if (i == bmu_idx)
-                    neurons[i].update_weights(sample, current_lr, 1.0);
-                break;
+                best.second = best.dist;
+                best.dist = d[k];
+                best.index = i + k;
+            }
+            else if (d[k] < best.second)
+                best.second = d[k];
+        }
+    }
+    for (; i < end; ++i)
+    {
+        double dist = distance_kernels.l2sq(x, W.row(i));
+        if (dist < best.dist)
+        {
+            best.second = best.dist;
+            best.dist = dist;
+            best.index = i;
+        }
+        else if (dist < best.second)
+            best.second = dist;
+    }
+    return best;
+}
+
+// Mejor candidato de [begin, end) para una muestra dispersa, durante el
+// entrenamiento online (pesos con escala diferida):
+//   ||x - w||^2 = ||x||^2 + ||w||^2 - 2 scale (x.v)
+// con ||w||^2 en prototype_norms, que update_weights_sparse mantiene al día.
+// Solo se leen las dimensiones no nulas de la muestra. Cada x.w queda en
+// sample_dot para la actualización.
+template <typename T>
+typename BasicRedKohonen<T>::BmuCandidate BasicRedKohonen<T>::find_bmu_sparse(const typename SparseMatrix<T>::Row &x, int begin, int end)
+{
+    TRACE_COUNT(DISTANCES, end - begin);
+    BmuCandidate best;
+    for (int i = begin; i < end; ++i)
+    {
+        double dot = weight_scale[i] * kernels::sparse_dot(x.idx, x.val, x.nnz, codebook.row(i));
+        sample_dot[i] = dot;
+        double dist = std::max(0.0, x.norm_sq + prototype_norms[i] - 2.0 * dot);
+        if (dist < best.dist)
+        {
+            best.second = best.dist;
+            best.dist = dist;
+            best.index = i;
+        }
+        else if (dist < best.second)
+            best.second = dist;
+    }
+    return best;
+}
+
+// Igual que find_bmu_in_range, pero cada distancia se abandona en cuanto su
+// suma parcial supera la mejor encontrada. La cota lleva un pequeño margen
+// relativo (mayor que el error de redondeo de la suma reordenada) y las
+// distancias que llegan al final se recalculan con el kernel normal, así que
+// la BMU y su distancia coinciden exactamente con las de find_bmu_in_range.
+//
+// `hint` (o -1) es una neurona probablemente cercana, por ejemplo la BMU de
+// la muestra en la época anterior: su distancia se calcula primero para que
+// la cota sea ajustada desde el principio, aunque esté fuera de [begin, end).
+// `dims` acumula las dimensiones sumadas.
+template <typename T>
+typename BasicRedKohonen<T>::BmuCandidate BasicRedKohonen<T>::find_bmu_partial(const T *x, int begin, int end, int hint, size_t &dims) const
+{
+    constexpr double slack = std::is_same_v<T, float> ? 1e-3 : 1e-9;
+    TRACE_COUNT(DISTANCES, end - begin);
+    BmuCandidate best;
+    double limit = std::numeric_limits<double>::max();
+    if (hint >= 0)
+    {
+        TRACE_COUNT(DISTANCES, 1);
+        limit = distance_to(hint, x);
+        dims += input_dim;
+    }
+
+    for (int i = begin; i < end; ++i)
+    {
+        const double bound = std::min(best.dist, limit) * (1.0 + slack);
+        size_t evaluated = 0;
+        double partial = kernels::l2sq_bounded(x, codebook.row(i), block_order.data(), block_order.size(),
+                                               input_dim, bound, evaluated);
+        dims += evaluated;
+        if (partial > bound)
+            continue;
+
+        double dist = distance_to(i, x);
+        if (dist < best.dist)
+        {
+            best.dist = dist;
+            best.index = i;
+        }
+    }
+    return best;
+}
+
+// Mejor candidato entre las neuronas de [begin, end) dentro de la ventana de
+// la malla centrada en `center` (caja de semiancho cache_window por eje).
+// `evaluated` acumula las distancias calculadas.
+template <typename T>
+typename BasicRedKohonen<T>::BmuCandidate BasicRedKohonen<T>::find_bmu_in_window(const T *x, int center, int begin, int end,
+                                                                                 size_t &evaluated) const
+{
+    BmuCandidate best;
+    auto [cx, cy, cz] = lattice_coords(center);
+    const int w = cache_window;
+    const int x0 = std::max(0, cx - w), x1 = std::min(dim_x - 1, cx + w);
 
-            case NeighborhoodMode::GAUSSIAN_RADIUS:
-                if (dist_to_bmu_sq < radius_sq)
+    for (int z = std::max(0, cz - w); z <= std::min(dim_z - 1, cz + w); ++z)
+    {
+        for (int y = std::max(0, cy - w); y <= std::min(dim_y - 1, cy + w); ++y)
+        {
+            const int row = dim_x * (y + dim_y * z);
+            const int from = std::max(row + x0, begin), to = std::min(row + x1, end - 1);
+            TRACE_COUNT(DISTANCES, std::max(0, to - from + 1));
+            evaluated += std::max(0, to - from + 1);
+            for (int i = from; i <= to; ++i)
+            {
+                double dist = distance_to(i, x);
+                if (dist < best.dist)
                 {
-                    double influence = exp(-dist_to_bmu_sq / (2 * radius_sq));
-                    neurons[i].update_weights(sample, current_lr, influence);
+                    best.dist = dist;
+                    best.index = i;
                 }
-                break;
+            }
+        }
+    }
+    return best;
+}
 
-            case NeighborhoodMode::CONSTANT_RADIUS:
-                if (dist_to_bmu_sq < radius_sq)
-                    neurons[i].update_weights(sample, current_lr, 1.0);
-                break;
+// true si todos los vecinos inmediatos de `idx` en la malla caen dentro de la
+// ventana de `center`, es decir, si la búsqueda local ya los comparó con idx
+template <typename T>
+bool BasicRedKohonen<T>::interior_of_window(int idx, int center) const
+{
+    auto [ix, iy, iz] = lattice_coords(idx);
+    auto [cx, cy, cz] = lattice_coords(center);
+    const int w = cache_window;
+    auto covered = [w](int i, int c, int dim)
+    {
+        return std::max(0, i - 1) >= std::max(0, c - w) && std::min(dim - 1, i + 1) <= std::min(dim - 1, c + w);
+    };
+    return covered(ix, cx, dim_x) && covered(iy, cy, dim_y) && covered(iz, cz, dim_z);
+}
+
+// Bloques en su orden natural (antes de conocer los datos de entrenamiento)
+template <typename T>
+void BasicRedKohonen<T>::reset_block_order()
+{
+    block_order.clear();
+    for (size_t from = 0; from < static_cast<size_t>(input_dim); from += kernels::BOUNDED_BLOCK)
+        block_order.push_back(static_cast<uint32_t>(from));
+    block_order_from_data = false;
+}
+
+// Ordena los bloques por la varianza total de sus dimensiones en los datos de
+// entrenamiento, de mayor a menor. Los bloques casi constantes (los bordes de
+// MNIST, casi siempre a cero) quedan al final, de modo que la suma parcial
+// crece rápido y PARTIAL_DISTANCE abandona antes.
+template <typename T>
+template <typename S>
+void BasicRedKohonen<T>::build_block_order(const Matrix<S> &X_train)
+{
+    reset_block_order();
+    if (X_train.empty())
+        return;
+
+    std::vector<double> sum(input_dim, 0.0), sum_sq(input_dim, 0.0);
+    Matrix<T> buffer(1, input_dim);
+    for (size_t s = 0; s < X_train.rows(); ++s)
+    {
+        const T *x = decode_sample(X_train.row(s), input_dim, buffer.data());
+        for (int j = 0; j < input_dim; ++j)
+        {
+            sum[j] += x[j];
+            sum_sq[j] += static_cast<double>(x[j]) * x[j];
+        }
+    }
+
+    const double n = static_cast<double>(X_train.rows());
+    std::vector<double> block_variance(block_order.size(), 0.0);
+    for (int j = 0; j < input_dim; ++j)
+    {
+        double mean = sum[j] / n;
+        block_variance[j / kernels::BOUNDED_BLOCK] += std::max(0.0, sum_sq[j] / n - mean * mean);
+    }
+
+    std::stable_sort(block_order.begin(), block_order.end(), [&](uint32_t a, uint32_t b)
+                     { return block_variance[a / kernels::BOUNDED_BLOCK] > block_variance[b / kernels::BOUNDED_BLOCK]; });
+    block_order_from_data = true;
+}
+
+// Distancia de cada neurona a la más cercana, con el mismo producto de
+// matrices por bloques que find_bmu_batch. Se resta un margen proporcional a
+// las normas para cubrir el error de cancelación de ||a||^2 + ||b||^2 - 2 a.b,
+// de modo que el resultado nunca supera la distancia real.
+template <typename T>
+void BasicRedKohonen<T>::build_nearest_prototypes()
+{
+    constexpr int TILE = 64;
+    constexpr int DIM_TILE = 256;
+    constexpr double tolerance = std::is_same_v<T, float> ? 1e-4 : 1e-10;
+    nearest_prototype.assign(total_neurons, std::numeric_limits<double>::infinity());
+
+#pragma omp parallel
+    {
+        std::vector<double> scores(TILE * TILE);
+
+#pragma omp for schedule(dynamic)
+        for (int i0 = 0; i0 < total_neurons; i0 += TILE)
+        {
+            int m = std::min(TILE, total_neurons - i0);
+            std::vector<double> nearest_sq(m, std::numeric_limits<double>::max());
+            for (int j0 = 0; j0 < total_neurons; j0 += TILE)
+            {
+                int nw = std::min(TILE, total_neurons - j0);
+                for (int k0 = 0; k0 < input_dim; k0 += DIM_TILE)
+                    kernels::dot_nt(codebook.row(i0) + k0, codebook.stride(), m, codebook.row(j0) + k0,
+                                    codebook.stride(), nw, std::min(DIM_TILE, input_dim - k0), scores.data(), TILE,
+                                    k0 > 0);
+
+                for (int a = 0; a < m; ++a)
+                {
+                    for (int b = 0; b < nw; ++b)
+                    {
+                        if (i0 + a == j0 + b)
+                            continue;
+                        double norms = prototype_norms[i0 + a] + prototype_norms[j0 + b];
+                        double d = norms - 2.0 * scores[a * TILE + b] - tolerance * norms;
+                        nearest_sq[a] = std::min(nearest_sq[a], d);
+                    }
+                }
             }
+            for (int a = 0; a < m; ++a)
+                if (nearest_sq[a] < std::numeric_limits<double>::max())
+                    nearest_prototype[i0 + a] = std::sqrt(std::max(0.0, nearest_sq[a]));
         }
     }
+}
 
-    double duration = stop_timer(start);
-    float val_acc = 0.0f;
+// Descarta las cotas de BmuSearch::BOUNDED (pesos nuevos o cambio de modo)
+template <typename T>
+void BasicRedKohonen<T>::reset_bounds()
+{
+    sample_bounds.clear();
+    val_bounds.clear();
+    reference = Matrix<T>();
+    eval_reference = Matrix<T>();
+    drift.assign(total_neurons, 0.0);
+    epoch_drift = last_epoch_drift = 0.0;
+}
 
-    std::cout << "Epoch " << epoch + 1 << "/" << epochs
-              << " | lr: " << current_lr;
+// BMUs del conjunto de validación con BmuSearch::BOUNDED. Desde la última
+// validación cada neurona se desplazó ||w - eval_reference||, así que la
+// distancia de una muestra a cualquier neurona distinta de su BMU anterior b
+// es al menos su cota inferior menos el mayor de esos desplazamientos. Si la
+// distancia actual a b es menor que eso, b sigue siendo la BMU; si no, se hace
+// la búsqueda completa (que renueva la cota). Devuelve las búsquedas evitadas.
+template <typename T>
+template <typename S>
+size_t BasicRedKohonen<T>::find_val_bmus(const Matrix<S> &X_val, std::vector<int> &bmus)
+{
+    constexpr double slack = std::is_same_v<T, float> ? 1e-3 : 1e-9;
+    const int n_samples = static_cast<int>(X_val.rows());
+    bmus.resize(n_samples);
+    if (val_bounds.size() != X_val.rows() || eval_reference.rows() != codebook.rows())
+        val_bounds.assign(n_samples, SampleBound{});
 
-    if (mode != NeighborhoodMode::BMU_ONLY)
-        std::cout << " | Radius: " << current_radius;
+    double max_moved = 0.0;
+    if (!eval_reference.empty())
+    {
+#pragma omp parallel for reduction(max : max_moved)
+        for (int j = 0; j < total_neurons; ++j)
+            max_moved = std::max(max_moved, std::sqrt(kernels::l2sq(codebook.row(j), eval_reference.row(j), input_dim)));
+    }
 
-    std::cout << " | Train Time: " << duration << "s";
+    size_t pruned = 0;
+#pragma omp parallel reduction(+ : pruned)
+    {
+        Matrix<T> buffer(1, input_dim);
 
-    if (validation_enabled)
+#pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < n_samples; ++i)
+        {
+            const T *x = decode_sample(X_val.row(i), input_dim, buffer.data());
+            SampleBound &state = val_bounds[i];
+            if (state.bmu >= 0)
+            {
+                double lower = state.lower - max_moved;
+                if (std::sqrt(distance_to(state.bmu, x)) * (1.0 + slack) < lower)
+                {
+                    bmus[i] = state.bmu;
+                    state.lower = lower;
+                    pruned++;
+                    continue;
+                }
+            }
+            BmuCandidate best = find_bmu_in_range(x, 0, total_neurons);
+            bmus[i] = best.index;
+            state = {best.index, std::sqrt(best.second), 0};
+        }
+    }
+    eval_reference = codebook;
+    return pruned;
+}
+
+// Llama a update(i, influencia) para cada neurona de [begin, end) con
+// influencia positiva en la caja de vecindad de la BMU
+template <typename T>
+template <typename F>
+void BasicRedKohonen<T>::for_each_neighbor(int bmu_idx, int begin, int end, F &&update) const
+{
+    auto [bmu_x, bmu_y, bmu_z] = lattice_coords(bmu_idx);
+
+    // Solo se recorre la caja [bmu - alcance, bmu + alcance] recortada a la malla
+    const int reach = influence_reach;
+    const int x0 = std::max(0, bmu_x - reach), x1 = std::min(dim_x - 1, bmu_x + reach);
+    const int y0 = std::max(0, bmu_y - reach), y1 = std::min(dim_y - 1, bmu_y + reach);
+    const int z0 = std::max(0, bmu_z - reach), z1 = std::min(dim_z - 1, bmu_z + reach);
+
+    for (int z = z0; z <= z1; ++z)
     {
-        assign_labels(X_val_data, Y_val_labels);
-        val_acc = test_accuracy(X_val_data, Y_val_labels);
-        std::cout << " | Val Acc: " << val_acc * 100.0f << "%";
+        for (int y = y0; y <= y1; ++y)
+        {
+            // Fila de la caja intersectada con el rango propio
+            const int row = dim_x * (y + dim_y * z);
+            const int from = std::max(row + x0, begin), to = std::min(row + x1, end - 1);
+            if (from > to)
+                continue;
+
+            const int dyz_sq = (y - bmu_y) * (y - bmu_y) + (z - bmu_z) * (z - bmu_z);
+            for (int i = from; i <= to; ++i)
+            {
+                double influence = influence_table[(i - row - bmu_x) * (i - row - bmu_x) + dyz_sq];
+                if (influence > 0.0)
+                {
+                    TRACE_COUNT(NEURONS_UPDATED, 1);
+                    update(i, influence);
+                }
+            }
+        }
     }
+}
 
-    if (log_file)
+// Actualiza las neuronas de [begin, end) que caen en la caja de vecindad de la
+// BMU. Con BmuSearch::BOUNDED actualiza el desplazamiento neto de cada neurona
+// en `drift` y devuelve el mayor de las neuronas tocadas (si no, 0).
+template <typename T>
+double BasicRedKohonen<T>::update_neighborhood(const T *x, int bmu_idx, double current_lr, int begin, int end)
+{
+    if (bmu_search != BmuSearch::BOUNDED)
     {
-        (*log_file) << "Epoch " << epoch + 1 << "/" << epochs
-                    << " | lr: " << current_lr;
+        for_each_neighbor(bmu_idx, begin, end, [&](int i, double influence)
+                          { neuron(i).update_weights(x, current_lr, influence); });
+        return 0.0;
+    }
+
+    double max_moved = 0.0;
+    for_each_neighbor(bmu_idx, begin, end, [&](int i, double influence)
+                      {
+                          double moved = neuron(i).update_weights_tracked(x, current_lr, influence, reference.row(i));
+                          drift[i] = moved;
+                          max_moved = std::max(max_moved, moved);
+                      });
+    return max_moved;
+}
+
+// Igual que update_neighborhood con una muestra dispersa: cada neurona solo
+// cambia en las dimensiones no nulas de la muestra y en su escala diferida
+template <typename T>
+void BasicRedKohonen<T>::update_neighborhood_sparse(const typename SparseMatrix<T>::Row &x, int bmu_idx,
+                                                    double current_lr, double min_scale, int begin, int end)
+{
+    for_each_neighbor(bmu_idx, begin, end, [&](int i, double influence)
+                      { neuron(i).update_weights_sparse(x.idx, x.val, x.nnz, x.norm_sq, sample_dot[i], current_lr, influence,
+                                                        min_scale, weight_scale[i], prototype_norms[i]); });
+}
 
-        if (mode != NeighborhoodMode::BMU_ONLY)
-            (*log_file) << " | Radius: " << current_radius;
+// Entrenamiento en línea dentro de una sola región paralela persistente.
+// Cada hilo es dueño de un rango fijo de neuronas: busca en él la mejor
+// candidata a BMU, y tras una única barrera por muestra todos conocen la BMU
+// global y actualizan solo sus propias neuronas. Los candidatos usan doble
+// buffer (por paridad de muestra), de modo que nadie sobrescribe un valor que
+// otro hilo aún puede estar leyendo.
+//
+// Con BmuSearch::CACHED_LOCAL se busca primero en la ventana de la malla
+// alrededor de la BMU de la época anterior. La mejor local se acepta (acierto)
+// si es un mínimo local de la malla (todos sus vecinos estaban en la ventana)
+// y su distancia no supera la que tuvo la muestra en la época anterior; si
+// no, se recorre el codebook completo con una segunda barrera. Es una cota
+// heurística: una neurona lejana en la malla podría seguir siendo mejor.
+//
+// Con BmuSearch::PARTIAL_DISTANCE cada hilo recorre su rango con
+// find_bmu_partial (mismo resultado que la búsqueda completa).
+//
+// Con BmuSearch::BOUNDED, antes de buscar se comprueba con cotas de
+// desigualdad triangular si la BMU anterior de la muestra sigue siéndolo; en
+// ese caso se ahorra la búsqueda completa. Necesita una barrera más por
+// muestra, para compartir los desplazamientos del paso anterior.
+template <typename T>
+template <typename S>
+typename BasicRedKohonen<T>::SearchStats BasicRedKohonen<T>::train_online(int epoch, const Matrix<S> &X_train, double current_lr)
+{
+    const size_t n_samples = X_train.rows();
+    const int n_threads = std::max(1, std::min(omp_get_max_threads(), total_neurons));
+    std::vector<BmuCandidate> candidates(2 * n_threads);
+    std::vector<BmuCandidate> fallback(2 * n_threads);
 
-        (*log_file) << " | Train Time: " << duration << "s";
+    // PARTIAL_DISTANCE también usa la caché, como pista para la cota inicial
+    const bool partial = bmu_search == BmuSearch::PARTIAL_DISTANCE;
+    const bool cached = bmu_search == BmuSearch::CACHED_LOCAL;
+    if ((cached || partial) && bmu_cache.size() != n_samples)
+        bmu_cache.assign(n_samples, CachedBmu{});
 
-        if (validation_enabled)
-            (*log_file) << " | Val Acc: " << val_acc * 100.0f << "%";
+    // Lo que cada hilo publica antes de decidir si hace falta buscar (BOUNDED):
+    // el mayor desplazamiento de sus neuronas en la época y, si la BMU
+    // anterior de la muestra es suya, la distancia actual a ella y su separación
+    struct alignas(64) Probe
+    {
+        double moved = 0.0;
+        double dist = -1.0;
+        double separation = 0.0;
+    };
+    constexpr double slack = std::is_same_v<T, float> ? 1e-3 : 1e-9;
+    const bool bounded = bmu_search == BmuSearch::BOUNDED;
+    std::vector<Probe> probes(bounded ? 2 * n_threads : 0);
+    if (bounded && sample_bounds.size() != n_samples)
+        sample_bounds.assign(n_samples, SampleBound{});
+    SearchStats stats;
+
+    ProgressReporter progress("Epoch " + std::to_string(epoch + 1) + "/" + std::to_string(epochs), n_samples);
+
+#pragma omp parallel num_threads(n_threads) proc_bind(close)
+    {
+        FlushToZero ftz;
+        const int tid = omp_get_thread_num();
+        const int nt = omp_get_num_threads();
+        const int begin = static_cast<int>(static_cast<long>(total_neurons) * tid / nt);
+        const int end = static_cast<int>(static_cast<long>(total_neurons) * (tid + 1) / nt);
+        Matrix<T> buffer(1, input_dim); // Muestra convertida (si no es de tipo T)
+        size_t dims = 0;
+        size_t evaluated = 0; // Distancias calculadas por este hilo
+        double own_moved = 0.0; // Mayor desplazamiento de las neuronas propias en la época
+        double moved = 0.0;     // El de todas, idéntico en todos los hilos
+        TRACE_LAP_BEGIN(lap);
+
+        for (size_t s = 0; s < n_samples; ++s)
+        {
+            const T *x = decode_sample(X_train.row(s), input_dim, buffer.data());
+
+            if (bounded)
+            {
+                // Copia: tid 0 reescribe la entrada al final del paso
+                const SampleBound state = sample_bounds[s];
+                Probe *probe = &probes[(s & 1) * nt];
+                probe[tid] = {own_moved, -1.0, 0.0};
+                if (state.bmu >= begin && state.bmu < end)
+                {
+                    TRACE_COUNT(DISTANCES, 1);
+                    evaluated++;
+                    probe[tid].dist = std::sqrt(distance_to(state.bmu, x));
+                    probe[tid].separation = nearest_prototype[state.bmu] - drift[state.bmu];
+                }
+                TRACE_LAP(lap, SEARCH_NS);
+
+#pragma omp barrier
+
+                TRACE_LAP(lap, SYNC_NS);
+
+                // Todos los hilos leen los mismos valores en el mismo orden
+                double dist = 0.0, separation = 0.0;
+                for (int t = 0; t < nt; ++t)
+                {
+                    moved = std::max(moved, probe[t].moved);
+                    if (probe[t].dist >= 0.0)
+                    {
+                        dist = probe[t].dist;
+                        separation = probe[t].separation;
+                    }
+                }
+
+                if (state.bmu >= 0 && state.epoch == epoch - 1)
+                {
+                    // Hamerly: la cota guardada es respecto a la referencia de
+                    // la época anterior, que cambió como mucho last_epoch_drift,
+                    // y desde entonces ninguna neurona se movió más que `moved`.
+                    // Elkan: ||x - w_j|| >= ||w_b - w_j|| - ||x - w_b||, con la
+                    // separación de b rebajada por lo que se movieron b y el resto.
+                    double lower = std::max(state.lower - last_epoch_drift - moved, separation - moved - dist);
+                    if (dist * (1.0 + slack) < lower)
+                    {
+                        own_moved = std::max(own_moved, update_neighborhood(x, state.bmu, current_lr, begin, end));
+                        if (tid == 0)
+                        {
+                            sample_bounds[s] = {state.bmu, lower - moved, epoch};
+                            stats.pruned++;
+                            progress.update(s + 1);
+                        }
+                        TRACE_LAP(lap, UPDATE_NS);
+                        continue;
+                    }
+                }
+            }
+
+            const int cached_bmu = cached || partial ? bmu_cache[s].index : -1;
+            const double cache_dist = cached ? bmu_cache[s].dist : 0.0;
+            BmuCandidate *slot = &candidates[(s & 1) * nt];
+            if (partial)
+            {
+                slot[tid] = find_bmu_partial(x, begin, end, cached_bmu, dims);
+                evaluated += end - begin + (cached_bmu >= 0 ? 1 : 0);
+            }
+            else if (cached_bmu >= 0)
+                slot[tid] = find_bmu_in_window(x, cached_bmu, begin, end, evaluated);
+            else
+            {
+                slot[tid] = find_bmu_in_range(x, begin, end);
+                evaluated += end - begin;
+            }
+            TRACE_LAP(lap, SEARCH_NS);
+
+#pragma omp barrier
+
+            BmuCandidate best = reduce_candidates(slot, nt);
+            if (cached && cached_bmu >= 0)
+            {
+                // Todos los hilos evalúan la misma cota sobre los mismos datos
+                if (interior_of_window(best.index, cached_bmu) && best.dist <= cache_dist)
+                {
+                    if (tid == 0)
+                        stats.cache_hits++;
+                }
+                else
+                {
+                    BmuCandidate *retry = &fallback[(s & 1) * nt];
+                    TRACE_LAP(lap, SYNC_NS);
+                    retry[tid] = find_bmu_in_range(x, begin, end);
+                    evaluated += end - begin;
+                    TRACE_LAP(lap, SEARCH_NS);
+
+#pragma omp barrier
+
+                    best = reduce_candidates(retry, nt);
+                }
+            }
+            TRACE_LAP(lap, SYNC_NS);
+
+            own_moved = std::max(own_moved, update_neighborhood(x, best.index, current_lr, begin, end));
+
+            if (tid == 0)
+            {
+                if (cached || partial)
+                    bmu_cache[s] = {best.index, best.dist};
+                if (bounded)
+                    sample_bounds[s] = {best.index, std::sqrt(best.second) - moved, epoch};
+                progress.update(s + 1);
+            }
+            TRACE_LAP(lap, UPDATE_NS);
+        }
+
+#pragma omp atomic
+        stats.dims += dims;
+#pragma omp atomic
+        stats.evaluated += evaluated;
+
+    }
+    // El máximo de cada hilo ya incluye su último paso
+    if (bounded)
+        epoch_drift = std::max(epoch_drift, *std::max_element(drift.begin(), drift.end()));
+    if (partial)
+        stats.distances = n_samples * total_neurons;
+    return stats;
+}
+
+// Entrenamiento en línea con muestras dispersas, con el mismo reparto de
+// neuronas por hilo y la misma barrera por muestra que la versión densa. La
+// búsqueda y la actualización solo recorren las dimensiones no nulas de la
+// muestra: las distancias usan las normas de los prototipos, que
+// update_weights_sparse mantiene al día, y el decaimiento (1 - a) w de los
+// pesos se acumula en una escala por neurona que se aplica al final de la
+// época (o antes, si se hace demasiado pequeña).
+template <typename T>
+typename BasicRedKohonen<T>::SearchStats BasicRedKohonen<T>::train_online(int epoch, const SparseMatrix<T> &X_train, double current_lr)
+{
+    // Por debajo de esta escala los pesos guardados crecen tanto que float
+    // perdería precisión al sumarles las muestras
+    constexpr double min_scale = std::is_same_v<T, float> ? 1e-2 : 1e-6;
+    const size_t n_samples = X_train.rows();
+    const int n_threads = std::max(1, std::min(omp_get_max_threads(), total_neurons));
+    std::vector<BmuCandidate> candidates(2 * n_threads);
+    weight_scale.assign(total_neurons, 1.0);
+    sample_dot.assign(total_neurons, 0.0);
+
+    ProgressReporter progress("Epoch " + std::to_string(epoch + 1) + "/" + std::to_string(epochs), n_samples);
+
+#pragma omp parallel num_threads(n_threads) proc_bind(close)
+    {
+        FlushToZero ftz;
+        const int tid = omp_get_thread_num();
+        const int nt = omp_get_num_threads();
+        const int begin = static_cast<int>(static_cast<long>(total_neurons) * tid / nt);
+        const int end = static_cast<int>(static_cast<long>(total_neurons) * (tid + 1) / nt);
+        TRACE_LAP_BEGIN(lap);
+
+        for (size_t s = 0; s < n_samples; ++s)
+        {
+            const auto x = X_train.row(s);
+            BmuCandidate *slot = &candidates[(s & 1) * nt];
+            slot[tid] = find_bmu_sparse(x, begin, end);
+            TRACE_LAP(lap, SEARCH_NS);
+
+#pragma omp barrier
+
+            BmuCandidate best = reduce_candidates(slot, nt);
+            TRACE_LAP(lap, SYNC_NS);
+            update_neighborhood_sparse(x, best.index, current_lr, min_scale, begin, end);
+            if (tid == 0)
+                progress.update(s + 1);
+            TRACE_LAP(lap, UPDATE_NS);
+        }
+
+        for (int i = begin; i < end; ++i)
+            neuron(i).apply_scale(weight_scale[i]);
+    }
+    weight_scale.clear();
+    sample_dot.clear();
+    return {};
+}
+
+// Entrenamiento online asíncrono al estilo Hogwild: cada hilo recorre su
+// propio tramo contiguo de muestras y, para cada una, busca la BMU y
+// actualiza su vecindad sin barreras ni bloqueos. Todos los accesos al
+// codebook compartido son atómicos relajados, elemento a elemento:
+// - La búsqueda usa una copia local del codebook, que el hilo vuelve a leer
+//   (kernels::load_shared) cada ASYNC_REFRESH muestras. Así recorre la copia
+//   con los kernels SIMD normales; leer cada fila con cargas atómicas en cada
+//   búsqueda multiplicaba por 6 el tiempo de la época.
+// - La actualización (Neuron::update_weights_relaxed) escribe en el codebook
+//   compartido y a la vez en la copia, de modo que el hilo siempre ve sus
+//   propias actualizaciones. Con un hilo el resultado es el del online
+//   secuencial.
+// Las de otros hilos le llegan con un retraso de hasta ASYNC_REFRESH muestras,
+// y una actualización concurrente de la misma neurona puede perder parte de
+// otra. Cuando el radio es pequeño las vecindades de muestras simultáneas casi
+// nunca se solapan.
+template <typename T>
+template <typename S>
+void BasicRedKohonen<T>::train_async(int epoch, const Matrix<S> &X_train, double current_lr)
+{
+    constexpr size_t ASYNC_REFRESH = 64; // Muestras entre lecturas completas del codebook compartido
+    const size_t n_samples = X_train.rows();
+    std::atomic<size_t> done{0};
+    ProgressReporter progress("Epoch " + std::to_string(epoch + 1) + "/" + std::to_string(epochs), n_samples);
+
+#pragma omp parallel
+    {
+        FlushToZero ftz;
+        Matrix<T> buffer(1, input_dim);            // Muestra convertida (si no es de tipo T)
+        Matrix<T> local(total_neurons, input_dim); // Copia del codebook para la búsqueda
+        size_t since_refresh = ASYNC_REFRESH;
+
+#pragma omp for schedule(static)
+        for (size_t s = 0; s < n_samples; ++s)
+        {
+            if (since_refresh++ == ASYNC_REFRESH)
+            {
+                for (int i = 0; i < total_neurons; ++i)
+                    kernels::load_shared(codebook.row(i), input_dim, local.row(i));
+                since_refresh = 1;
+            }
+            const T *x = decode_sample(X_train.row(s), input_dim, buffer.data());
+            const int bmu = find_bmu_in_rows(local, x, 0, total_neurons).index;
+            for_each_neighbor(bmu, 0, total_neurons, [&](int i, double influence)
+                              { neuron(i).update_weights_relaxed(x, current_lr, influence, local.row(i)); });
+            progress.update(done.fetch_add(1, std::memory_order_relaxed) + 1);
+        }
+    }
+}
+
+// Entrenamiento online por bloques de mini_batch_size muestras. Las BMUs de
+// cada bloque se buscan de una vez contra el codebook congelado (el mismo
+// producto de matrices que find_bmu_batch) y después cada neurona aplica
+// todas las actualizaciones del bloque de golpe. Si las muestras del bloque
+// cuya BMU es j suman S_j y son n_j, y a_j = lr h(i, j):
+//   r = prod_j (1 - a_j)^n_j
+//   w_i = r w_i + (1 - r) sum_j a_j S_j / sum_j a_j n_j
+// Es la composición de las actualizaciones online si todas las muestras de
+// la vecindad fueran iguales, así que nunca sobrepasa la media del bloque y
+// con B = 1 coincide con el online. Cada neurona y cada S_j se calculan
+// enteros en un solo hilo, recorriendo las muestras en su orden: el resultado
+// no depende del número de hilos.
+template <typename T>
+template <typename S>
+void BasicRedKohonen<T>::train_mini_batch(int epoch, const Matrix<S> &X_train, double current_lr)
+{
+    const size_t n_samples = X_train.rows();
+    const size_t block = static_cast<size_t>(mini_batch_size);
+    ProgressReporter progress("Epoch " + std::to_string(epoch + 1) + "/" + std::to_string(epochs), n_samples);
+
+    std::vector<int> bmus(block);
+    std::vector<int> first(total_neurons + 1); // Muestras del bloque por BMU: order[first[j], first[j + 1])
+    std::vector<int> order(block);
+    std::vector<int> touched;                  // BMUs con alguna muestra en el bloque
+    std::vector<int> affected;                 // Neuronas dentro de la vecindad de alguna de ellas
+    std::vector<char> marked(total_neurons, 0);
+    Matrix<double> sums(total_neurons, input_dim);
+
+    for (size_t s0 = 0; s0 < n_samples; s0 += block)
+    {
+        const size_t m = std::min(block, n_samples - s0);
+        const Matrix<S> X_block = X_train.slice(s0, m);
+        find_bmu_batch(X_block, std::span<int>(bmus.data(), m));
+
+        // Orden estable de las muestras por BMU (counting sort)
+        std::fill(first.begin(), first.end(), 0);
+        for (size_t a = 0; a < m; ++a)
+            first[bmus[a] + 1]++;
+        touched.clear();
+        for (int j = 0; j < total_neurons; ++j)
+        {
+            if (first[j + 1] > 0)
+                touched.push_back(j);
+            first[j + 1] += first[j];
+        }
+        {
+            std::vector<int> next(first.begin(), first.end() - 1);
+            for (size_t a = 0; a < m; ++a)
+                order[next[bmus[a]]++] = static_cast<int>(a);
+        }
+
+        affected.clear();
+        for (int j : touched)
+            for_each_neighbor(j, 0, total_neurons, [&](int i, double)
+                              {
+                                  if (!marked[i])
+                                  {
+                                      marked[i] = 1;
+                                      affected.push_back(i);
+                                  }
+                              });
+
+        const int n_touched = static_cast<int>(touched.size());
+        const int n_affected = static_cast<int>(affected.size());
+#pragma omp parallel
+        {
+            FlushToZero ftz;
+            Matrix<T> buffer(1, input_dim); // Muestra convertida (si no es de tipo T)
+            std::vector<double> numerator(input_dim);
+
+            // 1. S_j de cada BMU, sumando sus muestras en orden
+#pragma omp for schedule(dynamic, 4)
+            for (int t = 0; t < n_touched; ++t)
+            {
+                const int j = touched[t];
+                double *acc = sums.row(j);
+                std::fill(acc, acc + input_dim, 0.0);
+                for (int k = first[j]; k < first[j + 1]; ++k)
+                {
+                    const T *x = decode_sample(X_block.row(order[k]), input_dim, buffer.data());
+                    for (int d = 0; d < input_dim; ++d)
+                        acc[d] += x[d];
+                }
+            }
+
+            // 2. Actualización de cada neurona con las BMUs de su vecindad
+#pragma omp for schedule(dynamic, 8)
+            for (int t = 0; t < n_affected; ++t)
+            {
+                const int i = affected[t];
+                auto [x, y, z] = lattice_coords(i);
+                std::fill(numerator.begin(), numerator.end(), 0.0);
+                double denominator = 0.0;
+                double retain = 1.0;
+
+                const int reach = influence_reach;
+                for (int jz = std::max(0, z - reach); jz <= std::min(dim_z - 1, z + reach); ++jz)
+                {
+                    for (int jy = std::max(0, y - reach); jy <= std::min(dim_y - 1, y + reach); ++jy)
+                    {
+                        for (int jx = std::max(0, x - reach); jx <= std::min(dim_x - 1, x + reach); ++jx)
+                        {
+                            const int j = jx + dim_x * (jy + dim_y * jz);
+                            const int n_j = first[j + 1] - first[j];
+                            double h = influence_table[(x - jx) * (x - jx) + (y - jy) * (y - jy) + (z - jz) * (z - jz)];
+                            if (h == 0.0 || n_j == 0)
+                                continue;
+
+                            const double a = current_lr * h;
+                            const double *sum = sums.row(j);
+                            for (int d = 0; d < input_dim; ++d)
+                                numerator[d] += a * sum[d];
+                            denominator += a * n_j;
+                            retain *= std::pow(1.0 - a, n_j);
+                        }
+                    }
+                }
+
+                T *w = codebook.row(i);
+                const double step = (1.0 - retain) / denominator;
+                for (int d = 0; d < input_dim; ++d)
+                    w[d] = static_cast<T>(retain * w[d] + step * numerator[d]);
+                kernels::dot_nt(w, 0, 1, w, 0, 1, input_dim, &prototype_norms[i], 1);
+                marked[i] = 0;
+            }
+        }
+        progress.update(s0 + m);
+    }
+}
+
+// SOM por lotes: cada prototipo se recalcula una vez por época como
+//   w_i = sum_j h(i, j) S_j / sum_j h(i, j) n_j
+// donde S_j y n_j son la suma y el número de muestras cuya BMU es j.
+template <typename T>
+template <typename Samples>
+void BasicRedKohonen<T>::train_batch(const Samples &X_train)
+{
+    Matrix<double> sums(total_neurons, input_dim);
+    std::vector<double> counts(total_neurons, 0.0);
+    accumulate_batch(X_train, sums, counts);
+    smooth_batch(sums, counts, 0, total_neurons);
+}
+
+// Suma a sums / counts (S_j y n_j) las muestras de X_train agrupadas por BMU.
+// Las muestras se ordenan por BMU (counting sort, como en train_mini_batch) y
+// cada neurona la acumula entera un solo hilo, recorriendo sus muestras en
+// orden: no hay copias de sums por hilo y el resultado no depende del número
+// de hilos.
+template <typename T>
+template <typename Samples>
+void BasicRedKohonen<T>::accumulate_batch(const Samples &X_train, Matrix<double> &sums, std::span<double> counts) const
+{
+    // Las BMUs de toda la época se buscan de una vez con el producto de matrices
+    const size_t n_samples = X_train.rows();
+    std::vector<int> bmus(n_samples);
+    find_bmu_batch(X_train, bmus);
+    TRACE_SCOPE("batch_accumulate");
+
+    // Muestras de cada BMU: order[first[j], first[j + 1])
+    std::vector<size_t> first(total_neurons + 1, 0);
+    for (size_t s = 0; s < n_samples; ++s)
+        first[bmus[s] + 1]++;
+    for (int j = 0; j < total_neurons; ++j)
+        first[j + 1] += first[j];
+    std::vector<size_t> order(n_samples);
+    {
+        std::vector<size_t> next(first.begin(), first.end() - 1);
+        for (size_t s = 0; s < n_samples; ++s)
+            order[next[bmus[s]]++] = s;
+    }
+
+#pragma omp parallel
+    {
+        Matrix<T> buffer(1, input_dim); // Muestra convertida (solo densas)
+
+#pragma omp for schedule(dynamic, 8)
+        for (int i = 0; i < total_neurons; ++i)
+        {
+            if (first[i] == first[i + 1])
+                continue;
+            double *acc = sums.row(i);
+            for (size_t k = first[i]; k < first[i + 1]; ++k)
+            {
+                if constexpr (is_sparse_v<Samples>)
+                {
+                    // Solo se suman las entradas no nulas
+                    const auto x = X_train.row(order[k]);
+                    for (size_t e = 0; e < x.nnz; ++e)
+                        acc[x.idx[e]] += x.val[e];
+                }
+                else
+                {
+                    const T *x = decode_sample(X_train.row(order[k]), input_dim, buffer.data());
+                    for (int d = 0; d < input_dim; ++d)
+                        acc[d] += x[d];
+                }
+            }
+            counts[i] += static_cast<double>(first[i + 1] - first[i]);
+        }
+    }
+}
+
+// Nuevo prototipo de las neuronas de [begin, end) como media ponderada por la
+// vecindad de las sumas de la época
+template <typename T>
+void BasicRedKohonen<T>::smooth_batch(const Matrix<double> &sums, std::span<const double> counts, int begin, int end)
+{
+    TRACE_SCOPE("batch_update");
+#pragma omp parallel
+    {
+        std::vector<double> numerator(input_dim);
+#pragma omp for schedule(dynamic, 8)
+        for (int i = begin; i < end; ++i)
+        {
+            auto [x, y, z] = lattice_coords(i);
+            std::fill(numerator.begin(), numerator.end(), 0.0);
+            double denominator = 0.0;
+
+            // Solo contribuyen las neuronas dentro del alcance de la vecindad
+            const int reach = influence_reach;
+            for (int jz = std::max(0, z - reach); jz <= std::min(dim_z - 1, z + reach); ++jz)
+            {
+                for (int jy = std::max(0, y - reach); jy <= std::min(dim_y - 1, y + reach); ++jy)
+                {
+                    for (int jx = std::max(0, x - reach); jx <= std::min(dim_x - 1, x + reach); ++jx)
+                    {
+                        int j = jx + dim_x * (jy + dim_y * jz);
+                        double h = influence_table[(x - jx) * (x - jx) + (y - jy) * (y - jy) + (z - jz) * (z - jz)];
+                        if (h == 0.0 || counts[j] == 0.0)
+                            continue;
+
+                        const double *sum = sums.row(j);
+                        for (int k = 0; k < input_dim; ++k)
+                            numerator[k] += h * sum[k];
+                        denominator += h * counts[j];
+                    }
+                }
+            }
+
+            // Las neuronas sin muestras en su vecindad conservan sus pesos
+            if (denominator > 0.0)
+            {
+                T *w = codebook.row(i);
+                for (int k = 0; k < input_dim; ++k)
+                    w[k] = static_cast<T>(numerator[k] / denominator);
+            }
+        }
+    }
+}
+
+// Tasa de aprendizaje y radio de la época (decaimiento exponencial salvo con BMU_ONLY)
+template <typename T>
+checkpoint::State BasicRedKohonen<T>::epoch_schedule(int epoch) const
+{
+    checkpoint::State schedule{epoch, initial_learning_rate, initial_radius};
+    if (mode == NeighborhoodMode::GAUSSIAN_RADIUS || mode == NeighborhoodMode::CONSTANT_RADIUS)
+    {
+        schedule.learning_rate = initial_learning_rate * exp(-(double)epoch / epochs);
+        schedule.radius = initial_radius * exp(-(double)epoch / time_constant);
+    }
+    return schedule;
+}
+
+template <typename T>
+template <typename Samples>
+void BasicRedKohonen<T>::batch_partials(int epoch, const Samples &X_shard, Matrix<double> &sums, std::span<double> counts)
+{
+    TRACE_EPOCH(epoch);
+    refresh_codebook();
+    train_state = epoch_schedule(epoch);
+    build_influence_table(train_state.radius * train_state.radius);
+    accumulate_batch(X_shard, sums, counts);
+}
+
+template <typename T>
+void BasicRedKohonen<T>::batch_update(const Matrix<double> &sums, std::span<const double> counts, int begin, int end)
+{
+    smooth_batch(sums, counts, begin, end);
+}
+
+template <typename T>
+void BasicRedKohonen<T>::attach_codebook(Matrix<T> storage, bool publish)
+{
+    if (publish)
+        for (int i = 0; i < total_neurons; ++i)
+            std::copy(codebook.row(i), codebook.row(i) + input_dim, storage.row(i));
+    codebook = std::move(storage);
+    refresh_codebook();
+}
+
+template <typename T>
+void BasicRedKohonen<T>::refresh_codebook()
+{
+    refresh_norms();
+    bmu_cache.clear();
+    reset_bounds();
+}
+
+template <typename T>
+void BasicRedKohonen<T>::train(int epoch, const std::vector<std::vector<double>> &X_train, std::ofstream *log_file)
+{
+    train(epoch, Matrix<T>::from_rows(X_train), log_file);
+}
+
+template <typename T>
+template <typename Samples>
+void BasicRedKohonen<T>::train(int epoch, const Samples &X_train, std::ofstream *log_file)
+{
+    TRACE_EPOCH(epoch);
+    auto start = start_timer();
+
+    const checkpoint::State schedule = epoch_schedule(epoch);
+    const double current_lr = schedule.learning_rate;
+    const double current_radius = schedule.radius;
+    build_influence_table(current_radius * current_radius);
+
+    // Con muestras dispersas el entrenamiento online usa siempre la búsqueda
+    // exacta, y ASYNC y MINI_BATCH se entrenan como ONLINE
+    constexpr bool sparse = is_sparse_v<Samples>;
+    const bool online = algorithm == TrainingAlgorithm::ONLINE && !sparse;
+    const bool partial = online && bmu_search == BmuSearch::PARTIAL_DISTANCE;
+    const bool bounded = online && bmu_search == BmuSearch::BOUNDED;
+    if constexpr (!sparse)
+    {
+        if (partial && !block_order_from_data)
+            build_block_order(X_train);
+    }
+    if (bounded)
+    {
+        // Nueva referencia: el codebook al empezar la época
+        last_epoch_drift = epoch_drift;
+        epoch_drift = 0.0;
+        reference = codebook;
+        drift.assign(total_neurons, 0.0);
+        build_nearest_prototypes();
+    }
+
+    SearchStats stats;
+    {
+        TRACE_SCOPE("train");
+        if (algorithm == TrainingAlgorithm::BATCH)
+            train_batch(X_train);
+        else if constexpr (!sparse)
+        {
+            if (algorithm == TrainingAlgorithm::ASYNC)
+                train_async(epoch, X_train, current_lr);
+            else if (algorithm == TrainingAlgorithm::MINI_BATCH)
+                train_mini_batch(epoch, X_train, current_lr);
+            else
+                stats = train_online(epoch, X_train, current_lr);
+        }
+        else
+            stats = train_online(epoch, X_train, current_lr);
+        refresh_norms();
+    }
+    train_state = schedule;
+
+    report_epoch(epoch, stop_timer(start), online ? bmu_search : BmuSearch::EXACT, stats, X_train.rows(), log_file);
+}
+
+// Una época recorriendo un flujo de bloques leídos del disco (ver
+// SampleStream.hpp): cada bloque se entrena como un conjunto completo
+// mientras el flujo lee el siguiente. El SOM por lotes acumula S_j y n_j de
+// todos los bloques y recalcula los prototipos una sola vez. La caché de BMUs
+// y las cotas se asocian al índice de cada muestra, así que con un flujo la
+// búsqueda es siempre exacta.
+template <typename T>
+template <typename S>
+void BasicRedKohonen<T>::train(int epoch, SampleStream<S> &stream, std::ofstream *log_file)
+{
+    TRACE_EPOCH(epoch);
+    auto start = start_timer();
+
+    const checkpoint::State schedule = epoch_schedule(epoch);
+    const double current_lr = schedule.learning_rate;
+    build_influence_table(schedule.radius * schedule.radius);
+
+    size_t n_samples = 0;
+    {
+        TRACE_SCOPE("train");
+        const BmuSearch search = std::exchange(bmu_search, BmuSearch::EXACT);
+        const bool batch = algorithm == TrainingAlgorithm::BATCH;
+        Matrix<double> sums;
+        std::vector<double> counts;
+        if (batch)
+        {
+            sums = Matrix<double>(total_neurons, input_dim);
+            counts.assign(total_neurons, 0.0);
+        }
+
+        stream.rewind();
+        while (const SampleChunk<S> *chunk = stream.next())
+        {
+            n_samples += chunk->X.rows();
+            if (batch)
+                accumulate_batch(chunk->X, sums, counts);
+            else if (algorithm == TrainingAlgorithm::ASYNC)
+                train_async(epoch, chunk->X, current_lr);
+            else if (algorithm == TrainingAlgorithm::MINI_BATCH)
+                train_mini_batch(epoch, chunk->X, current_lr);
+            else
+                train_online(epoch, chunk->X, current_lr);
+        }
+        if (batch)
+            smooth_batch(sums, counts, 0, total_neurons);
+        bmu_search = search;
+        refresh_norms();
     }
+    train_state = schedule;
+
+    report_epoch(epoch, stop_timer(start), BmuSearch::EXACT, SearchStats{}, n_samples, log_file);
 }
 
-float RedKohonen::test_accuracy(const std::vector<std::vector<double>> &X_test, const std::vector<int> &Y_test) const
+// Informe de una época en consola y en el log, con la validación si está
+// activa. `search` es la búsqueda que usó realmente el entrenamiento.
+template <typename T>
+void BasicRedKohonen<T>::report_epoch(int epoch, double duration, BmuSearch search, const SearchStats &stats,
+                                      size_t n_samples, std::ofstream *log_file)
+{
+    const bool cached = search == BmuSearch::CACHED_LOCAL;
+    const bool partial = search == BmuSearch::PARTIAL_DISTANCE;
+    const bool bounded = search == BmuSearch::BOUNDED;
+    // La búsqueda exacta compara cada muestra con todas las neuronas; las
+    // demás cuentan en train_online las distancias que calculan de verdad
+    train_distances += search == BmuSearch::EXACT ? n_samples * total_neurons : stats.evaluated;
+
+    // La misma línea va a la consola y al log
+    std::ostringstream line;
+    line << "Epoch " << epoch + 1 << "/" << epochs;
+
+    if (algorithm == TrainingAlgorithm::BATCH)
+        line << " | Batch";
+    else
+        line << " | lr: " << train_state.learning_rate;
+    if (algorithm == TrainingAlgorithm::ASYNC)
+        line << " | Async";
+    if (algorithm == TrainingAlgorithm::MINI_BATCH)
+        line << " | Mini-batch: " << mini_batch_size;
+
+    if (mode != NeighborhoodMode::BMU_ONLY)
+        line << " | Radius: " << train_state.radius;
+
+    line << " | Train Time: " << duration << "s";
+
+    if (cached)
+        line << " | BMU Cache: " << (n_samples == 0 ? 0.0 : 100.0 * stats.cache_hits / n_samples) << "%";
+    if (partial)
+        line << " | Avg Dims: " << (stats.distances == 0 ? 0.0 : static_cast<double>(stats.dims) / stats.distances)
+             << "/" << input_dim;
+    if (bounded)
+        line << " | Pruned: " << (n_samples == 0 ? 0.0 : 100.0 * stats.pruned / n_samples) << "%";
+
+    // Con la evaluación asíncrona la validación la hace run_epochs sobre una
+    // copia del codebook (sin las cotas de BOUNDED)
+    if (defer_evaluation)
+    {
+        deferred_line = line.str();
+        return;
+    }
+
+    // Las BMUs de validación se calculan una vez para etiquetar, medir la precisión y el error de cuantización
+    if (validation_enabled)
+    {
+        float val_acc = 0.0f;
+        double val_qe = -1.0; // La búsqueda acotada no calcula distancias
+        double val_pruned_rate = 0.0;
+        std::visit([&](const auto &X_val)
+                   {
+                       TRACE_SCOPE("validation");
+                       if constexpr (!is_sparse_v<std::decay_t<decltype(X_val)>>)
+                       {
+                           if (bounded)
+                           {
+                               std::vector<int> bmus(X_val.rows());
+                               size_t val_pruned = find_val_bmus(X_val, bmus);
+                               val_pruned_rate = X_val.empty() ? 0.0 : 100.0 * val_pruned / X_val.rows();
+                               val_acc = evaluate_bmus(bmus, {}, Y_val_labels).accuracy;
+                               return;
+                           }
+                       }
+                       Evaluation eval = evaluate(X_val, Y_val_labels);
+                       val_acc = eval.accuracy;
+                       val_qe = eval.quantization_error;
+                   },
+                   X_val_data);
+        line << " | Val Acc: " << val_acc * 100.0f << "%";
+        if (val_qe >= 0.0)
+            line << " | Val QE: " << val_qe;
+        if (bounded)
+            line << " | Val Pruned: " << val_pruned_rate << "%";
+    }
+
+    std::cout << line.str();
+    if (log_file)
+        (*log_file) << line.str();
+}
+
+template <typename T>
+float BasicRedKohonen<T>::test_accuracy(const std::vector<std::vector<double>> &X_test, const std::vector<int> &Y_test) const
+{
+    return test_accuracy(Matrix<T>::from_rows(X_test), Y_test);
+}
+
+template <typename T>
+template <typename Samples>
+float BasicRedKohonen<T>::test_accuracy(const Samples &X_test, const std::vector<int> &Y_test) const
+{
+    TRACE_SCOPE("test_accuracy");
+    std::vector<int> bmus(X_test.rows());
+    find_bmu_batch(X_test, bmus);
+    return accuracy_from(bmus, Y_test);
+}
+
+template <typename T>
+float BasicRedKohonen<T>::accuracy_from(const std::vector<int> &bmus, const std::vector<int> &Y) const
 {
     int correct_predictions = 0;
-#pragma omp parallel for reduction(+ : correct_predictions)
-    for (size_t i = 0; i < X_test.size(); ++i)
+    for (size_t i = 0; i < bmus.size(); ++i)
     {
-        if (predict(X_test[i]) == Y_test[i])
+        if (labels[bmus[i]] == Y[i])
         {
             correct_predictions++;
         }
     }
-    return static_cast<float>(correct_predictions) / X_test.size();
+    return static_cast<float>(correct_predictions) / bmus.size();
 }
 
-void RedKohonen::train_test(const std::vector<std::vector<double>> &X_train,
+template <typename T>
+void BasicRedKohonen<T>::train_test(const std::vector<std::vector<double>> &X_train,
                             const std::vector<std::vector<double>> &X_test,
                             const std::vector<int> &Y_test, const std::string &weights_filename)
+{
+    train_test(Matrix<T>::from_rows(X_train), Matrix<T>::from_rows(X_test), Y_test, weights_filename);
+}
+
+template <typename T>
+template <typename F, typename Samples>
+void BasicRedKohonen<T>::run_epochs(F &&train_epoch, const Samples &X_test, const std::vector<int> &Y_test,
+                                    const std::string &weights_filename)
 {
     std::string output_dir = "output/" + weights_filename;
     std::filesystem::create_directories(output_dir);
-    std::ofstream log_file(output_dir + "/log.txt");
+    TRACE_SESSION_BEGIN(output_dir);
+
+    // Si se cargó un checkpoint se continúa tras su última época
+    const int first_epoch = train_state.epoch + 1;
+    std::ofstream log_file(output_dir + "/log.txt", first_epoch > 0 ? std::ios::app : std::ios::trunc);
 
     float best_test_acc = 0.0f;
     int best_epoch = -1;
-    for (int epoch = 0; epoch < epochs; ++epoch)
+
+    // Cierra la línea de la época con la precisión de test y guarda los
+    // checkpoints de `model`: la propia red o su copia en la evaluación asíncrona
+    auto finish_epoch = [&](int epoch, const BasicRedKohonen &model, float test_acc, double total_time)
     {
-        auto start = start_timer();
-        train(epoch, X_train, &log_file);
-        float test_acc = test_accuracy(X_test, Y_test);
-        double total_time = stop_timer(start);
         std::cout << " | Test Acc: " << test_acc * 100.0f
                   << "% | Total Time: " << total_time << "s" << std::endl;
 
@@ -212,19 +1699,78 @@ void RedKohonen::train_test(const std::vector<std::vector<double>> &X_train,
                      << "% | Total Time: " << total_time << "s" << std::endl;
         }
 
-        if ((epoch + 1) % 5 == 0)
-        {
-            save_weights(output_dir + "/checkpoint.dat");
-        }
+        if ((epoch + 1) % checkpoint_interval == 0)
+            model.save_weights(output_dir + "/checkpoint.dat");
 
         // Guardar el mejor modelo
         if (test_acc > best_test_acc)
         {
             best_test_acc = test_acc;
             best_epoch = epoch;
-            save_weights(output_dir + "/best_model.dat");
+            model.save_weights(output_dir + "/best_model.dat");
+        }
+    };
+
+    if (!async_evaluation)
+    {
+        for (int epoch = first_epoch; epoch < epochs; ++epoch)
+        {
+            auto start = start_timer();
+            train_epoch(epoch, &log_file);
+            float test_acc = test_accuracy(X_test, Y_test);
+            finish_epoch(epoch, *this, test_acc, stop_timer(start));
+            TRACE_EPOCH_END(epoch);
         }
     }
+    else
+    {
+        // Al terminar cada época se copia el codebook y una tarea en segundo
+        // plano valida, mide el test y guarda los checkpoints de la copia
+        // mientras se entrena la época siguiente. Antes de lanzar una tarea se
+        // espera a la anterior (y se adoptan sus etiquetas), así que hay una
+        // sola evaluación en curso y los resultados salen en orden.
+        defer_evaluation = true;
+        std::future<std::vector<int>> pending;
+        for (int epoch = first_epoch; epoch < epochs; ++epoch)
+        {
+            auto start = start_timer();
+            train_epoch(epoch, &log_file);
+            if (pending.valid())
+                labels = pending.get();
+
+            auto snapshot = std::make_shared<BasicRedKohonen>(input_dim, dim_x, dim_y, dim_z, 0.0, 0, mode, algorithm);
+            snapshot->attach_codebook(Matrix<T>(codebook), false);
+            snapshot->labels = labels;
+            snapshot->train_state = train_state;
+
+            pending = std::async(std::launch::async,
+                                 [&, epoch, start, snapshot, line = std::move(deferred_line)]
+                                 {
+                                     TRACE_SCOPE("async_evaluation");
+                                     omp_set_num_threads(evaluation_threads);
+                                     std::ostringstream out;
+                                     out << line;
+                                     if (validation_enabled)
+                                     {
+                                         Evaluation eval = std::visit([&](const auto &X_val)
+                                                                      { return snapshot->evaluate(X_val, Y_val_labels); },
+                                                                      X_val_data);
+                                         out << " | Val Acc: " << eval.accuracy * 100.0f << "%"
+                                             << " | Val QE: " << eval.quantization_error;
+                                     }
+                                     float test_acc = snapshot->test_accuracy(X_test, Y_test);
+                                     std::cout << out.str();
+                                     if (log_file.is_open())
+                                         log_file << out.str();
+                                     finish_epoch(epoch, *snapshot, test_acc, stop_timer(start));
+                                     return snapshot->labels;
+                                 });
+            TRACE_EPOCH_END(epoch);
+        }
+        if (pending.valid())
+            labels = pending.get();
+        defer_evaluation = false;
+    }
     save_weights(output_dir + "/final.dat");
     if (log_file.is_open())
     {
@@ -234,84 +1780,102 @@ void RedKohonen::train_test(const std::vector<std::vector<double>> &X_train,
     std::cout << "Best Test Accuracy: " << best_test_acc * 100.0f
               << "% at epoch " << (best_epoch + 1) << std::endl;
     log_file.close();
+    TRACE_SESSION_END();
 }
 
-void RedKohonen::save_weights(const std::string &filename) const
+template <typename T>
+template <typename Samples>
+void BasicRedKohonen<T>::train_test(const Samples &X_train, const Samples &X_test,
+                                    const std::vector<int> &Y_test, const std::string &weights_filename)
 {
-    std::ofstream file(filename);
-    if (!file.is_open())
-    {
-        std::cerr << "Error al guardar pesos: " << filename << std::endl;
-        return;
-    }
+    run_epochs([&](int epoch, std::ofstream *log_file) { train(epoch, X_train, log_file); },
+               X_test, Y_test, weights_filename);
+}
 
-    for (const auto &neuron : neurons)
-    {
-        const auto &weights = neuron.get_weights();
-        for (size_t i = 0; i < weights.size(); ++i)
-            file << weights[i] << (i == weights.size() - 1 ? "" : ",");
-        file << std::endl;
-    }
-    file.close();
+template <typename T>
+template <typename S>
+void BasicRedKohonen<T>::train_test(SampleStream<S> &train_stream, const Matrix<S> &X_test,
+                                    const std::vector<int> &Y_test, const std::string &weights_filename)
+{
+    run_epochs([&](int epoch, std::ofstream *log_file) { train(epoch, train_stream, log_file); },
+               X_test, Y_test, weights_filename);
 }
 
-void RedKohonen::load_weights(const std::string &filename)
+template <typename T>
+void BasicRedKohonen<T>::save_weights(const std::string &filename) const
 {
-    std::ifstream file(filename);
-    if (!file.is_open())
-    {
-        std::cerr << "Error al abrir archivo de pesos: " << filename << std::endl;
-        return;
-    }
+    TRACE_SCOPE("save_weights");
+    checkpoint::save(filename, codebook, dim_x, dim_y, dim_z, labels, train_state);
+}
 
-    std::string line;
-    if (std::getline(file, line))
+template <typename T>
+void BasicRedKohonen<T>::load_weights(const std::string &filename)
+{
+    TRACE_SCOPE("load_weights");
+    checkpoint::Data<T> data;
+    if (checkpoint::load(filename, data) && load_weights(std::move(data)))
+        std::cout << "Pesos cargados desde " << filename << " (época " << train_state.epoch + 1 << ")" << std::endl;
+}
+
+template <typename T>
+bool BasicRedKohonen<T>::load_weights(checkpoint::Data<T> data)
+{
+    if (static_cast<int>(data.weights.cols()) != input_dim)
     {
-        std::stringstream ss(line);
-        ss >> dim_x >> dim_y >> dim_z;
-        total_neurons = dim_x * dim_y * dim_z;
-        neurons.clear();
-        neurons.reserve(total_neurons);
+        std::cerr << "Error: El checkpoint tiene dimensión de entrada " << data.weights.cols()
+                  << " y la red " << input_dim << "." << std::endl;
+        return false;
     }
-    else
+
+    // El radio inicial solo se recalcula si cambia la malla: así se conserva el
+    // start_radius de una red de grano fino
+    const bool resized = data.dim_x != dim_x || data.dim_y != dim_y || data.dim_z != dim_z;
+    dim_x = data.dim_x;
+    dim_y = data.dim_y;
+    dim_z = data.dim_z;
+    total_neurons = dim_x * dim_y * dim_z;
+    codebook = std::move(data.weights);
+    labels = std::move(data.labels);
+    train_state = data.state;
+    if (epochs > 0 && resized)
     {
-        std::cerr << "Error: Archivo de pesos vacío o corrupto." << std::endl;
-        return;
+        initial_radius = std::max({dim_x, dim_y, dim_z}) / 2.0;
+        time_constant = epochs / log(initial_radius);
     }
 
-    while (std::getline(file, line))
-    {
-        if (line.empty() || std::all_of(line.begin(), line.end(), ::isspace))
-            continue;
+    refresh_norms();
+    bmu_cache.clear();
+    reset_bounds();
+    return true;
+}
 
-        std::vector<double> weights;
-        std::stringstream ss(line);
-        std::string value;
-        while (std::getline(ss, value, ','))
-        {
-            try
-            {
-                weights.push_back(std::stod(value));
-            }
-            catch (...)
-            {
-                weights.push_back(0.0);
-            }
-        }
+// Instanciaciones para los tipos escalares de la red y, en cada uno, para los
+// tipos de muestra admitidos (ver Samples.hpp)
+template class BasicRedKohonen<double>;
+template class BasicRedKohonen<float>;
 
-        if (!weights.empty())
-        {
-            Neuron n;
-            n.set_weights_from_load(weights);
-            neurons.push_back(n);
-        }
-    }
+#define KOHONEN_SAMPLE_METHODS(T, S)                                                                                   \
+    template void BasicRedKohonen<T>::set_validation_data<S>(Matrix<S>, const std::vector<int> &);                    \
+    template void BasicRedKohonen<T>::find_bmu_batch<S>(const Matrix<S> &, std::span<int>, std::span<double>) const;  \
+    template void BasicRedKohonen<T>::train<S>(int, SampleStream<S> &, std::ofstream *);                            \
+    template void BasicRedKohonen<T>::train_test<S>(SampleStream<S> &, const Matrix<S> &, const std::vector<int> &,   \
+                                                    const std::string &);                                              \
+    KOHONEN_GENERIC_METHODS(T, Matrix<S>)
 
-    if (neurons.size() != static_cast<size_t>(total_neurons))
-    {
-        std::cerr << "Advertencia: número de neuronas cargadas no coincide con el esperado." << std::endl;
-    }
+// Métodos que aceptan cualquier contenedor de muestras (densas o dispersas)
+#define KOHONEN_GENERIC_METHODS(T, X)                                                                                  \
+    template void BasicRedKohonen<T>::assign_labels<X>(const X &, const std::vector<int> &);                          \
+    template Evaluation BasicRedKohonen<T>::evaluate<X>(const X &, const std::vector<int> &);                         \
+    template void BasicRedKohonen<T>::train<X>(int, const X &, std::ofstream *);                                      \
+    template void BasicRedKohonen<T>::batch_partials<X>(int, const X &, Matrix<double> &, std::span<double>);          \
+    template float BasicRedKohonen<T>::test_accuracy<X>(const X &, const std::vector<int> &) const;                   \
+    template void BasicRedKohonen<T>::train_test<X>(const X &, const X &, const std::vector<int> &, const std::string &);
 
-    file.close();
-    std::cout << "Pesos cargados desde " << filename << std::endl;
-}
\ No newline at end of file
+KOHONEN_SAMPLE_METHODS(double, double)
+KOHONEN_SAMPLE_METHODS(double, uint8_t)
+KOHONEN_SAMPLE_METHODS(float, float)
+KOHONEN_SAMPLE_METHODS(float, uint8_t)
+KOHONEN_GENERIC_METHODS(double, SparseMatrix<double>)
+KOHONEN_GENERIC_METHODS(float, SparseMatrix<float>)
+#undef KOHONEN_SAMPLE_METHODS
+#undef KOHONEN_GENERIC_METHODS
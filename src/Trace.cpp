@@ -0,0 +1,233 @@
+// Volcado de la instrumentación por fases (ver Trace.hpp). Sin
+// KOHONEN_TRACING este archivo queda vacío.
+#ifdef KOHONEN_TRACING
+
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace trace
+{
+  std::atomic<int32_t> current_epoch{-1};
+
+  namespace
+  {
+    constexpr size_t N_COUNTERS = static_cast<size_t>(Counter::COUNT);
+    using Counters = std::array<uint64_t, N_COUNTERS>;
+
+    struct PhaseTotal
+    {
+      const char *name;
+      uint64_t calls = 0;
+      uint64_t ns = 0;
+    };
+
+    struct Tracer
+    {
+      std::mutex mtx; // Protege todo lo demás
+      std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+      std::ofstream out;
+      std::string dir;
+      bool first_event = true;
+      std::map<int, std::vector<PhaseTotal>> phases; // Por época, en orden de aparición
+      std::map<int, Counters> counters;              // Incremento de cada época
+      Counters last_totals{};
+
+      bool running = false;
+      std::condition_variable stop_cv;
+      std::thread flusher;
+
+      void write_event(const std::string &json)
+      {
+        out << (first_event ? "\n" : ",\n") << json;
+        first_event = false;
+      }
+
+      Counters totals() const
+      {
+        Counters sum{};
+        for (const auto &b : buffers)
+          for (size_t c = 0; c < N_COUNTERS; ++c)
+            sum[c] += b->counters[c].load(std::memory_order_relaxed);
+        return sum;
+      }
+
+      // Vacía los buffers de todos los hilos (con mtx tomado)
+      void drain()
+      {
+        for (const auto &b : buffers)
+        {
+          const uint64_t t = b->tail.load(std::memory_order_relaxed);
+          const uint64_t h = b->head.load(std::memory_order_acquire);
+          for (uint64_t i = t; i < h; ++i)
+          {
+            const Event &e = b->events[i % ThreadBuffer::CAPACITY];
+            std::vector<PhaseTotal> &epoch_phases = phases[e.epoch];
+            auto it = std::find_if(epoch_phases.begin(), epoch_phases.end(),
+                                   [&](const PhaseTotal &p) { return std::string_view(p.name) == e.name; });
+            if (it == epoch_phases.end())
+              it = epoch_phases.insert(epoch_phases.end(), PhaseTotal{e.name});
+            it->calls++;
+            it->ns += e.dur_ns;
+
+            if (out.is_open())
+            {
+              std::ostringstream json;
+              json << std::fixed << std::setprecision(3) << "{\"name\":\"" << e.name
+                   << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid << ",\"ts\":" << e.start_ns / 1e3
+                   << ",\"dur\":" << e.dur_ns / 1e3 << ",\"args\":{\"epoch\":" << e.epoch + 1 << "}}";
+              write_event(json.str());
+            }
+          }
+          b->tail.store(h, std::memory_order_release);
+        }
+      }
+
+      void write_summary() const
+      {
+        std::ofstream summary(dir + "/trace_summary.txt");
+        if (!summary.is_open())
+        {
+          std::cerr << "Error: No se pudo crear " << dir << "/trace_summary.txt" << std::endl;
+          return;
+        }
+        summary << std::fixed << std::setprecision(3);
+        for (const auto &[epoch, list] : phases)
+        {
+          if (epoch < 0)
+            summary << "Fuera de épocas";
+          else
+            summary << "Epoch " << epoch + 1;
+          for (const PhaseTotal &p : list)
+            summary << " | " << p.name << ": " << p.ns / 1e9 << "s (" << p.calls << ")";
+
+          auto it = counters.find(epoch);
+          if (it != counters.end())
+          {
+            const Counters &c = it->second;
+            summary << " | Distancias: " << c[static_cast<size_t>(Counter::DISTANCES)]
+                    << " | Neuronas actualizadas: " << c[static_cast<size_t>(Counter::NEURONS_UPDATED)];
+            if (c[static_cast<size_t>(Counter::SEARCH_NS)] > 0)
+              summary << " | Búsqueda (suma de hilos): " << c[static_cast<size_t>(Counter::SEARCH_NS)] / 1e9
+                      << "s | Barrera: " << c[static_cast<size_t>(Counter::SYNC_NS)] / 1e9
+                      << "s | Actualización: " << c[static_cast<size_t>(Counter::UPDATE_NS)] / 1e9 << "s";
+          }
+          summary << "\n";
+        }
+
+        uint64_t dropped = 0;
+        for (const auto &b : buffers)
+          dropped += b->dropped.load(std::memory_order_relaxed);
+        if (dropped > 0)
+          summary << "Eventos descartados (buffer lleno): " << dropped << "\n";
+      }
+    };
+
+    // Nunca se destruye: los hilos de OpenMP conservan punteros a sus buffers
+    Tracer &tracer()
+    {
+      static Tracer *t = new Tracer;
+      return *t;
+    }
+  }
+
+  ThreadBuffer *register_thread()
+  {
+    Tracer &t = tracer();
+    std::lock_guard<std::mutex> lock(t.mtx);
+    t.buffers.push_back(std::make_unique<ThreadBuffer>());
+    t.buffers.back()->tid = static_cast<uint32_t>(t.buffers.size() - 1);
+    return t.buffers.back().get();
+  }
+
+  void begin_epoch(int epoch)
+  {
+    current_epoch.store(epoch, std::memory_order_relaxed);
+  }
+
+  // Se llama fuera de las regiones paralelas: los contadores ya no cambian
+  void end_epoch(int epoch)
+  {
+    Tracer &t = tracer();
+    std::lock_guard<std::mutex> lock(t.mtx);
+    Counters now = t.totals();
+    Counters &delta = t.counters[epoch];
+    for (size_t c = 0; c < N_COUNTERS; ++c)
+      delta[c] += now[c] - t.last_totals[c];
+    t.last_totals = now;
+
+    if (t.out.is_open())
+    {
+      std::ostringstream json;
+      json << std::fixed << std::setprecision(3) << "{\"name\":\"contadores\",\"ph\":\"C\",\"pid\":1,\"ts\":"
+           << now_ns() / 1e3 << ",\"args\":{\"distancias\":" << delta[static_cast<size_t>(Counter::DISTANCES)]
+           << ",\"neuronas_actualizadas\":" << delta[static_cast<size_t>(Counter::NEURONS_UPDATED)] << "}}";
+      t.write_event(json.str());
+    }
+  }
+
+  void begin_session(const std::string &dir)
+  {
+    Tracer &t = tracer();
+    std::lock_guard<std::mutex> lock(t.mtx);
+    if (t.running)
+      return;
+
+    t.dir = dir;
+    t.out.open(dir + "/trace.json", std::ios::trunc);
+    if (!t.out.is_open())
+    {
+      std::cerr << "Error: No se pudo crear " << dir << "/trace.json" << std::endl;
+      return;
+    }
+    t.out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    t.first_event = true;
+    t.phases.clear();
+    t.counters.clear();
+    t.last_totals = t.totals();
+
+    t.running = true;
+    t.flusher = std::thread([&t]
+                            {
+                              std::unique_lock<std::mutex> lock(t.mtx);
+                              while (!t.stop_cv.wait_for(lock, std::chrono::milliseconds(100), [&t] { return !t.running; }))
+                                t.drain();
+                            });
+  }
+
+  void end_session()
+  {
+    Tracer &t = tracer();
+    {
+      std::lock_guard<std::mutex> lock(t.mtx);
+      if (!t.running)
+        return;
+      t.running = false;
+    }
+    t.stop_cv.notify_one();
+    t.flusher.join();
+
+    std::lock_guard<std::mutex> lock(t.mtx);
+    t.drain();
+    for (const auto &b : t.buffers)
+      t.write_event("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(b->tid) +
+                    ",\"args\":{\"name\":\"hilo " + std::to_string(b->tid) + "\"}}");
+    t.out << "\n]}\n";
+    t.out.close();
+    t.write_summary();
+    current_epoch.store(-1, std::memory_order_relaxed);
+  }
+}
+
+#endif
@@ -6,8 +6,10 @@
 #include <limits>
 #include <algorithm>
 #include <string>
-#include "Loader.hpp"
+#include "Checkpoint.hpp"
+#include "Kernels.hpp"
 #include "Reader.hpp"
+#include "Samples.hpp"
 
 const int GRID_SIZE = 10;
 const int IMAGE_SIZE = 28;
@@ -19,23 +21,25 @@ static float cam_yaw = 45.0f, cam_pitch = 30.0f;
 static int last_x = 0, last_y = 0;
 static bool left_down = false;
 
-std::vector<std::vector<double>> weights;
-std::vector<std::vector<double>> X_test, Y_test_oh;
+// Pesos (vista sobre el checkpoint mapeado, sin copia) y etiqueta asignada a
+// cada neurona durante el entrenamiento
+checkpoint::Data<double> som;
+Matrix<uint8_t> X_test;
+std::vector<int> Y_test;
 int pred_idx = -1, pred_digit = -1, true_digit = -1;
 
 std::string input_text = "";
 bool over_button = false;
 
 // BMU
-int find_bmu(const std::vector<double> &sample) {
+int find_bmu(const uint8_t *pixels) {
+    static std::vector<double> buffer;
+    buffer.resize(X_test.cols());
+    const double *sample = decode_sample(pixels, X_test.cols(), buffer.data());
     double best = std::numeric_limits<double>::max();
     int bi = 0;
-    for (size_t i = 0; i < weights.size(); ++i) {
-        double d = 0;
-        for (size_t j = 0; j < sample.size(); ++j) {
-            double diff = sample[j] - weights[i][j];
-            d += diff * diff;
-        }
+    for (size_t i = 0; i < som.weights.rows(); ++i) {
+        double d = kernels::l2sq(sample, som.weights.row(i), X_test.cols());
         if (d < best) {
             best = d;
             bi = static_cast<int>(i);
@@ -46,21 +50,22 @@ int find_bmu(const std::vector<double> &sample) {
 
 // Clase ViewNeuron
 class ViewNeuron {
-    const std::vector<double> &image;
+    const double *image; // Fila del codebook
+    size_t size;
     float radius;
     float mesh_r, mesh_g, mesh_b;
     bool highlight;
 public:
-    ViewNeuron(float r_in, const std::vector<double> &img,
+    ViewNeuron(float r_in, const double *img, size_t n,
                float br = 1.0f, float bg = 1.0f, float bb = 1.0f,
                float mr = 0.0f, float mg = 1.0f, float mb = 0.0f)
-        : image(img), radius(r_in), mesh_r(mr), mesh_g(mg), mesh_b(mb), highlight(false) {}
+        : image(img), size(n), radius(r_in), mesh_r(mr), mesh_g(mg), mesh_b(mb), highlight(false) {}
 
     void set_highlight(bool h) { highlight = h; }
 
     void draw(float x, float y, float z) const {
-        if (image.empty()) return;
-        auto [min_it, max_it] = std::minmax_element(image.begin(), image.end());
+        if (size == 0) return;
+        auto [min_it, max_it] = std::minmax_element(image, image + size);
         double mn = *min_it, mx = *max_it, range = mx - mn;
 
         glPushMatrix();
@@ -111,7 +116,7 @@ void drawUI() {
 
     // Etiqueta
     glColor3f(1, 1, 1);
-    drawText(20, 960, "Indice de muestra [0-" + std::to_string(X_test.size() - 1) + "]:");
+    drawText(20, 960, "Indice de muestra [0-" + std::to_string(X_test.rows() - 1) + "]:");
 
     // Cuadro de texto (input)
     glColor3f(1, 1, 1);
@@ -162,13 +167,12 @@ void drawUI() {
 
 
 void predict_and_highlight(int idx) {
-    if (idx < 0 || idx >= (int)X_test.size()) return;
-    pred_idx = find_bmu(X_test[idx]);
+    if (idx < 0 || idx >= (int)X_test.rows()) return;
+    pred_idx = find_bmu(X_test.row(idx));
 
     // Calcular etiqueta verdadera y predicha
-    auto &y_true = Y_test_oh[idx];
-    true_digit = std::distance(y_true.begin(), std::max_element(y_true.begin(), y_true.end()));
-    pred_digit = pred_idx % 10; // heurística (ajústala si tienes etiquetas de BMU reales)
+    true_digit = Y_test[idx];
+    pred_digit = som.labels[pred_idx];
 
     for (int i = 0; i < (int)neurons.size(); ++i)
         neurons[i].set_highlight(i == pred_idx);
@@ -245,17 +249,20 @@ void initGL() {
 }
 
 int main(int argc, char **argv) {
-    weights = load_som_weights_txt("output/mnist_gaussian_radius/best_model.dat");
-    if (weights.empty()) { std::cerr << "Error al cargar pesos\n"; return 1; }
+    if (!checkpoint::load("output/mnist_gaussian_radius/best_model.dat", som) || som.weights.empty()) {
+        std::cerr << "Error al cargar pesos\n"; return 1;
+    }
 
-    Reader::load_csv("database/mnist_test_flat.csv", X_test, Y_test_oh, 10);
+    Reader::load_mnist("database/mnist_test.kds", "database/t10k-images.idx3-ubyte",
+                       "database/t10k-labels.idx1-ubyte", X_test, Y_test);
     if (X_test.empty()) { std::cerr << "Error al cargar test\n"; return 1; }
+    if (som.weights.cols() != X_test.cols()) { std::cerr << "Error: Los pesos no tienen la dimensión de las imágenes\n"; return 1; }
 
     float mesh_r = 182.0f / 255.0f, mesh_g = 174.0f / 255.0f, mesh_b = 235.0f / 255.0f;
-    for (size_t i = 0; i < weights.size(); ++i)
-        neurons.emplace_back(0.85f, weights[i], 1.0f, 1.0f, 1.0f, mesh_r, mesh_g, mesh_b);
+    for (size_t i = 0; i < som.weights.rows(); ++i)
+        neurons.emplace_back(0.85f, som.weights.row(i), som.weights.cols(), 1.0f, 1.0f, 1.0f, mesh_r, mesh_g, mesh_b);
 
-    pred_idx = find_bmu(X_test[0]);
+    pred_idx = find_bmu(X_test.row(0));
     neurons[pred_idx].set_highlight(true);
 
     glutInit(&argc, argv);